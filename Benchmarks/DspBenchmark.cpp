@@ -0,0 +1,358 @@
+/*
+  ==============================================================================
+
+    DspBenchmark.cpp
+
+    Measures MoorerReverbEngine, and MoorerReverbBank per instance (where
+    ch counts instances), across block sizes, sample rates, mono, stereo
+    and 7.1.4, every comb/interleaving/eco variant, the double-precision
+    engine, the other topologies, pipelined mode and automation (reverb
+    time and damping moved every block, so the combs never stop gliding),
+    and reports the cost per sample, the realtime factor and the delay
+    lines' memory. Pipelined mode is timed on the calling thread, which,
+    running blocks back to back, waits on the worker whenever the late
+    stage is the slower half. --json writes the results to a file so runs
+    from different versions can be compared; --trace writes a per-stage
+    Chrome trace of each variant at 48k, stereo, 512-sample blocks. The
+    kernels run on the widest instruction set the CPU has; set
+    MOORER_ISA=sse2|avx2|avx512 to measure a narrower one.
+
+    moorer_benchmark [--quick] [--seconds <s>] [--json <path>] [--trace <path>]
+
+  ==============================================================================
+*/
+
+#include "DSP/MoorerReverbBank.h"
+#include "DSP/MoorerReverbEngine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifndef MOORER_VERSION
+ #define MOORER_VERSION "unknown"
+#endif
+
+#ifndef MOORER_BUILD_TYPE
+ #define MOORER_BUILD_TYPE "unknown"
+#endif
+
+namespace
+{
+    struct Variant
+    {
+        const char* name;
+        MoorerReverbEngine::CombEngine combEngine;
+        bool interleave;
+        bool multichannelOnly;          // there's nothing to interleave in mono
+        bool wide;                      // also run at 12 channels
+        int decimation;
+        bool doublePrecision;
+        TopologyPreset topology;
+        bool pipelined {false};
+        bool automated {false};
+    };
+
+    const Variant variants[] = {
+        { "scalar",             MoorerReverbEngine::CombEngine::scalar, false, false, true,  1, false, TopologyPreset::moorer },
+        { "simd",               MoorerReverbEngine::CombEngine::simd,   false, false, true,  1, false, TopologyPreset::moorer },
+        { "scalar-interleaved", MoorerReverbEngine::CombEngine::scalar, true,  true,  false, 1, false, TopologyPreset::moorer },
+        { "simd-interleaved",   MoorerReverbEngine::CombEngine::simd,   true,  true,  true,  1, false, TopologyPreset::moorer },
+        { "scalar-eco2",        MoorerReverbEngine::CombEngine::scalar, false, false, false, 2, false, TopologyPreset::moorer },
+        { "scalar-eco4",        MoorerReverbEngine::CombEngine::scalar, false, false, false, 4, false, TopologyPreset::moorer },
+        { "double",             MoorerReverbEngine::CombEngine::scalar, false, false, true,  1, true,  TopologyPreset::moorer },
+        { "double-interleaved", MoorerReverbEngine::CombEngine::scalar, true,  true,  false, 1, true,  TopologyPreset::moorer },
+        { "schroeder",          MoorerReverbEngine::CombEngine::scalar, false, false, false, 1, false, TopologyPreset::schroeder },
+        { "dense",              MoorerReverbEngine::CombEngine::scalar, false, false, false, 1, false, TopologyPreset::dense },
+        { "pipelined",          MoorerReverbEngine::CombEngine::scalar, false, false, true,  1, false, TopologyPreset::moorer, true },
+        { "automated",          MoorerReverbEngine::CombEngine::scalar, false, false, true,  1, false, TopologyPreset::moorer, false, true },
+    };
+
+    struct Result
+    {
+        std::string variant;
+        double sampleRate;
+        int channels, blockSize;
+        double nsPerSample, realtimeFactor;
+        size_t delayMemoryBytes;
+    };
+
+    /* best of a few runs over `seconds` of noise; the time includes copying
+       each input block into place, which is the same for every variant */
+    template <typename SampleType, typename Topology>
+    Result run(const Variant& variant, double sampleRate, int channels, int blockSize, double seconds)
+    {
+        BasicMoorerReverbEngine<SampleType, Topology> engine;
+        engine.setCombEngine(variant.combEngine);
+        engine.setInterleaveChannels(variant.interleave);
+        engine.setDecimation(variant.decimation);
+        engine.setPipelined(variant.pipelined);
+        engine.prepare(sampleRate, channels);
+
+        const int numBlocks = std::max(1, (int)(seconds*sampleRate)/blockSize);
+
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+        std::vector<std::vector<SampleType>> source((size_t)channels), data((size_t)channels);
+        std::vector<SampleType*> pointers;
+        for (int c = 0; c < channels; ++c) {
+            auto& s = source[(size_t)c];
+            s.resize((size_t)std::max(blockSize, 8192));
+            for (auto& x : s)
+                x = noise(rng);
+            data[(size_t)c].resize((size_t)blockSize);
+            pointers.push_back(data[(size_t)c].data());
+        }
+
+        // an automated variant swaps between these every block
+        MoorerReverbParameters automation[2];
+        automation[1].reverbTime = 0.8f;
+        automation[1].damping = 1.2f;
+
+        auto processBlocks = [&](int count) {
+            size_t read = 0;
+            for (int block = 0; block < count; ++block) {
+                if (read + (size_t)blockSize > source[0].size())
+                    read = 0;
+                for (int c = 0; c < channels; ++c)
+                    std::memcpy(pointers[(size_t)c], source[(size_t)c].data() + read, sizeof(SampleType)*(size_t)blockSize);
+                if (variant.automated)
+                    engine.setParameters(automation[block & 1]);
+                engine.process(pointers.data(), channels, blockSize);
+                read += (size_t)blockSize;
+            }
+        };
+
+        // fill the delay lines so every run reads warm, non-zero state
+        processBlocks(std::max(1, (int)(0.25*sampleRate)/blockSize));
+
+        double best = 1e30;
+        for (int repeat = 0; repeat < 3; ++repeat) {
+            const auto start = std::chrono::steady_clock::now();
+            processBlocks(numBlocks);
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        const double frames = (double)numBlocks*blockSize;
+        return { variant.name, sampleRate, channels, blockSize,
+                 best*1e9/(frames*channels), (frames/sampleRate)/best, engine.getDelayMemoryBytes() };
+    }
+
+    Result run(const Variant& variant, double sampleRate, int channels, int blockSize, double seconds)
+    {
+        return withTopology(variant.topology, [&](auto topology) {
+            using Topology = decltype(topology);
+            return variant.doublePrecision ? run<double, Topology>(variant, sampleRate, channels, blockSize, seconds)
+                                           : run<float, Topology>(variant, sampleRate, channels, blockSize, seconds);
+        });
+    }
+
+    /* the same for a MoorerReverbBank of numInstances mono reverbs, reported
+       per instance so it lines up with a mono engine's cost */
+    Result runBank(double sampleRate, int numInstances, int blockSize, double seconds)
+    {
+        MoorerReverbBank bank;
+        bank.prepare(sampleRate, numInstances);
+
+        const int numBlocks = std::max(1, (int)(seconds*sampleRate)/blockSize);
+
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+        std::vector<float> source((size_t)std::max(blockSize, 8192));
+        for (auto& x : source)
+            x = noise(rng);
+        std::vector<std::vector<float>> data((size_t)numInstances, std::vector<float>((size_t)blockSize));
+        std::vector<float*> pointers;
+        for (auto& instance : data)
+            pointers.push_back(instance.data());
+
+        auto processBlocks = [&](int count) {
+            size_t read = 0;
+            for (int block = 0; block < count; ++block) {
+                if (read + (size_t)blockSize > source.size())
+                    read = 0;
+                for (auto* instance : pointers)
+                    std::memcpy(instance, source.data() + read, sizeof(float)*(size_t)blockSize);
+                bank.process(pointers.data(), pointers.data(), blockSize);
+                read += (size_t)blockSize;
+            }
+        };
+
+        processBlocks(std::max(1, (int)(0.25*sampleRate)/blockSize));
+
+        double best = 1e30;
+        for (int repeat = 0; repeat < 3; ++repeat) {
+            const auto start = std::chrono::steady_clock::now();
+            processBlocks(numBlocks);
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        const double frames = (double)numBlocks*blockSize;
+        return { "bank", sampleRate, numInstances, blockSize,
+                 best*1e9/(frames*numInstances), (frames/sampleRate)/best, bank.getMemoryBytes() };
+    }
+
+    void writeTrace(const char* path, double seconds)
+    {
+        StageProfiler profiler(1 << 20);
+        ChromeTraceWriter writer(profiler, path);
+        if (! writer.isOpen())
+            return;
+
+        std::vector<float> left(512), right(512);
+        float* channels[2] = { left.data(), right.data() };
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+
+        // the stages cost the same in double, give or take the width, so only float Moorer is traced
+        for (const auto& variant : variants) {
+            if (variant.doublePrecision || variant.topology != TopologyPreset::moorer)
+                continue;
+
+            MoorerReverbEngine engine;
+            engine.setCombEngine(variant.combEngine);
+            engine.setInterleaveChannels(variant.interleave);
+            engine.setDecimation(variant.decimation);
+            engine.prepare(48000.0, 2);
+            engine.setProfiler(&profiler);
+
+            for (int block = 0; block < (int)(seconds*48000.0)/512; ++block) {
+                for (int k = 0; k < 512; ++k) {
+                    left[(size_t)k] = noise(rng);
+                    right[(size_t)k] = noise(rng);
+                }
+                engine.process(channels, 2, 512);
+            }
+        }
+    }
+
+    std::string compilerName()
+    {
+       #if defined(__clang__)
+        return "clang " __clang_version__;
+       #elif defined(__GNUC__)
+        return "gcc " __VERSION__;
+       #elif defined(_MSC_VER)
+        return "msvc " + std::to_string(_MSC_VER);
+       #else
+        return "unknown";
+       #endif
+    }
+
+    bool writeJson(const char* path, const std::vector<Result>& results, double seconds)
+    {
+        FILE* file = std::fopen(path, "w");
+        if (file == nullptr)
+            return false;
+
+        char timestamp[32];
+        const std::time_t now = std::time(nullptr);
+        std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+        std::fprintf(file, "{\n");
+        std::fprintf(file, "  \"version\": \"%s\",\n", MOORER_VERSION);
+        std::fprintf(file, "  \"build_type\": \"%s\",\n", MOORER_BUILD_TYPE);
+        std::fprintf(file, "  \"compiler\": \"%s\",\n", compilerName().c_str());
+        std::fprintf(file, "  \"simd_kernel\": %s,\n", CombBank::hasSimdKernel() ? "true" : "false");
+        std::fprintf(file, "  \"isa\": \"%s\",\n", DspKernels::getIsaName(DspKernels::best().isa));
+        std::fprintf(file, "  \"timestamp\": \"%s\",\n", timestamp);
+        std::fprintf(file, "  \"seconds_per_case\": %g,\n", seconds);
+        std::fprintf(file, "  \"results\": [\n");
+
+        for (size_t i = 0; i < results.size(); ++i) {
+            const auto& r = results[i];
+            std::fprintf(file, "    { \"variant\": \"%s\", \"sample_rate\": %g, \"channels\": %d, \"block_size\": %d, "
+                               "\"ns_per_sample\": %.4f, \"realtime_factor\": %.2f, \"delay_memory_bytes\": %zu }%s\n",
+                         r.variant.c_str(), r.sampleRate, r.channels, r.blockSize,
+                         r.nsPerSample, r.realtimeFactor, r.delayMemoryBytes, i + 1 < results.size() ? "," : "");
+        }
+
+        std::fprintf(file, "  ]\n}\n");
+        std::fclose(file);
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool quick = false;
+    double seconds = 2.0;
+    const char* jsonPath = nullptr;
+    const char* tracePath = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = std::max(0.001, std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else {
+            std::fprintf(stderr, "usage: %s [--quick] [--seconds <s>] [--json <path>] [--trace <path>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<int> blockSizes;
+    for (int size = 1; size <= 8192; size *= 2)
+        blockSizes.push_back(size);
+    std::vector<double> sampleRates { 44100.0, 48000.0, 88200.0, 96000.0, 192000.0 };
+
+    if (quick) {
+        blockSizes = { 1, 64, 8192 };
+        sampleRates = { 44100.0, 192000.0 };
+        seconds = std::min(seconds, 0.05);
+    }
+
+    std::vector<Result> results;
+    std::printf("kernels: %s\n", DspKernels::getIsaName(DspKernels::best().isa));
+    std::printf("%-20s %9s %3s %6s %12s %10s\n", "variant", "rate", "ch", "block", "ns/sample", "realtime");
+
+    for (const double sampleRate : sampleRates) {
+        for (const int channels : { 1, 2, 12 }) {
+            for (const auto& variant : variants) {
+                if ((variant.multichannelOnly && channels == 1) || (channels > 2 && ! variant.wide))
+                    continue;
+                if (variant.combEngine == MoorerReverbEngine::CombEngine::simd && ! CombBank::hasSimdKernel())
+                    continue;
+
+                for (const int blockSize : blockSizes) {
+                    results.push_back(run(variant, sampleRate, channels, blockSize, seconds));
+                    const auto& r = results.back();
+                    std::printf("%-20s %9.0f %3d %6d %12.2f %9.1fx\n", r.variant.c_str(), r.sampleRate,
+                                r.channels, r.blockSize, r.nsPerSample, r.realtimeFactor);
+                }
+            }
+        }
+    }
+
+    // a bank's instances share vectors eight at a time, so its cost per instance should fall up to a full group
+    for (const double sampleRate : sampleRates) {
+        for (const int numInstances : { 1, 8, 12, 64 }) {
+            for (const int blockSize : blockSizes) {
+                results.push_back(runBank(sampleRate, numInstances, blockSize, seconds));
+                const auto& r = results.back();
+                std::printf("%-20s %9.0f %3d %6d %12.2f %9.1fx\n", r.variant.c_str(), r.sampleRate,
+                            r.channels, r.blockSize, r.nsPerSample, r.realtimeFactor);
+            }
+        }
+    }
+
+    if (tracePath != nullptr)
+        writeTrace(tracePath, std::min(seconds, 0.5));
+
+    if (jsonPath != nullptr && ! writeJson(jsonPath, results, seconds)) {
+        std::fprintf(stderr, "couldn't write %s\n", jsonPath);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*
+  ==============================================================================
+
+    ParameterSnapshotBenchmark.cpp
+
+    Compares the old per-sample processBlock, which loaded every parameter
+    through an atomic on each sample/comb/channel iteration, against the
+    engine taking one parameter snapshot per block (both with settled and with
+    constantly automated parameters).
+
+    Built as the parameter_benchmark target of the CMake build.
+
+  ==============================================================================
+*/
+
+#include "DSP/MoorerReverbEngine.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+namespace
+{
+    /* the per-sample loop as it was before the block engine, with each
+       parameter behind an atomic the way AudioParameterFloat stores it */
+    struct PerSampleReverb
+    {
+        std::atomic<float> reverbTime {0.875f}, predelay1 {0.02f}, damping {0.7f}, wetMix {1.0f};
+
+        const float firDelayLengths[6] = { 0.0f, 0.0155f, 0.019f, 0.0215f, 0.05f, 0.0597f };
+        const float firCoefficients[6] = { 0.921f, 0.818f, 0.635f, 0.719f, 0.267f, 0.242f };
+        const float iirDelayLengths[6] = { 0.05f, 0.056f, 0.061f, 0.068f, 0.072f, 0.078f };
+        const float iirCoefficients[6] = { 0.46f, 0.48f, 0.5f, 0.52f, 0.53f, 0.55f };
+
+        double sampleRate {48000.0};
+        int delayBufferLength {0}, delayWrite {0};
+        std::vector<std::vector<float>> inputDelay, firDelay, combDelays, combDelay, allpassDelay;
+
+        void prepare(double newSampleRate)
+        {
+            sampleRate = newSampleRate;
+            delayBufferLength = (int)(0.2*sampleRate);
+            inputDelay.assign(2, std::vector<float>((size_t)delayBufferLength));
+            firDelay = combDelay = allpassDelay = inputDelay;
+            combDelays.assign(12, std::vector<float>((size_t)delayBufferLength));
+        }
+
+        void iirCombFilter(float* output, float* input, int writePtr, float delay, float feedback)
+        {
+            int dpr = (int)(writePtr - delay*sampleRate + delayBufferLength) % delayBufferLength;
+            float xd = input[dpr];
+            float fb = output[dpr];
+            dpr = (int)(dpr - 1 + delayBufferLength) % delayBufferLength;
+            float fblp = (1-feedback)*(fb + feedback*(output[dpr]));
+            output[writePtr] = reverbTime.load()*(xd + fblp);
+        }
+
+        void allpassFilter(float* output, float* input, int writePtr, float delay)
+        {
+            int dpr = (int)(writePtr - delay*sampleRate + delayBufferLength) % delayBufferLength;
+            output[writePtr] = -0.7*input[writePtr] + input[dpr] + 0.7*output[dpr];
+        }
+
+        void process(float* const* channels, int numChannels, int numSamples)
+        {
+            const int rate = (int)sampleRate;
+            int dpr, dpw = delayWrite;
+
+            for (int channel = 0; channel < numChannels; ++channel) {
+                float* channelData = channels[channel];
+                float* inputDelayData = inputDelay[(size_t)channel].data();
+                float* firDelayData = firDelay[(size_t)channel].data();
+                float* combDelayData = combDelay[(size_t)channel].data();
+                float* allpassDelayData1 = allpassDelay[(size_t)channel].data();
+                dpw = delayWrite;
+
+                for (int sample = 0; sample < numSamples; ++sample) {
+                    const float in = channelData[sample];
+                    inputDelayData[dpw] = in;
+                    firDelayData[dpw] = in;
+
+                    for (int i = 0; i < 6; i++) {
+                        dpr = (int)(dpw - (predelay1.load()+firDelayLengths[i])*rate + 2*delayBufferLength) % delayBufferLength;
+                        firDelayData[dpw] += firCoefficients[i] * inputDelayData[dpr];
+                    }
+
+                    float combSum = 0.0f;
+                    for (int i = 0; i < 6; i++) {
+                        float* currentComb = combDelays[(size_t)(channel + 2*i)].data();
+                        iirCombFilter(currentComb, firDelayData, dpw, iirDelayLengths[i], damping.load()*iirCoefficients[i]);
+                        combSum += currentComb[dpw];
+                    }
+                    combDelayData[dpw] = combSum;
+
+                    allpassFilter(allpassDelayData1, combDelayData, dpw, 0.006f);
+
+                    dpr = (int)(dpw - (0.029f+predelay1.load())*rate + delayBufferLength) % delayBufferLength;
+                    const float out = 0.15f*(firDelayData[dpw] + allpassDelayData1[dpr]);
+                    channelData[sample] = (1.0f-wetMix.load())*in + wetMix.load()*out;
+
+                    dpw = (dpw + 1) % delayBufferLength;
+                }
+            }
+
+            delayWrite = dpw;
+        }
+    };
+
+    constexpr double benchSampleRate = 48000.0;
+    constexpr int benchBlockSize = 512;
+    constexpr int benchSeconds = 20;
+
+    template <typename Process>
+    double nsPerSample(Process&& process)
+    {
+        std::vector<float> left(benchBlockSize), right(benchBlockSize);
+        float* channels[2] = { left.data(), right.data() };
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+
+        const int numBlocks = (int)(benchSeconds*benchSampleRate)/benchBlockSize;
+        double seconds = 0.0;
+
+        for (int block = 0; block < numBlocks; ++block) {
+            for (int k = 0; k < benchBlockSize; ++k) {
+                left[(size_t)k] = noise(rng);
+                right[(size_t)k] = noise(rng);
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            process(channels, block);
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        // per sample frame, i.e. both channels
+        return seconds*1e9/((double)numBlocks*benchBlockSize);
+    }
+}
+
+int main()
+{
+    PerSampleReverb perSample;
+    perSample.prepare(benchSampleRate);
+    const double perSampleNs = nsPerSample([&](float* const* channels, int) {
+        perSample.process(channels, 2, benchBlockSize);
+    });
+
+    MoorerReverbEngine settled;
+    settled.prepare(benchSampleRate, 2);
+    const double settledNs = nsPerSample([&](float* const* channels, int) {
+        settled.setParameters(MoorerReverbParameters());
+        settled.process(channels, 2, benchBlockSize);
+    });
+
+    // new targets every block, so every ramp is always running
+    MoorerReverbEngine automated;
+    automated.prepare(benchSampleRate, 2);
+    const double automatedNs = nsPerSample([&](float* const* channels, int block) {
+        const float phase = (float)(block % 64)/64.0f;
+        MoorerReverbParameters parameters;
+        parameters.reverbTime = 0.6f + 0.3f*phase;
+        parameters.predelay = 0.01f + 0.05f*phase;
+        parameters.damping = 0.5f + phase;
+        parameters.wetMix = 0.5f + 0.5f*phase;
+        automated.setParameters(parameters);
+        automated.process(channels, 2, benchBlockSize);
+    });
+
+    std::printf("stereo, %.0f Hz, %d-sample blocks\n", benchSampleRate, benchBlockSize);
+    std::printf("  per-sample atomic reads : %7.2f ns/sample\n", perSampleNs);
+    std::printf("  block snapshot, settled : %7.2f ns/sample (%.1fx)\n", settledNs, perSampleNs/settledNs);
+    std::printf("  block snapshot, ramping : %7.2f ns/sample (%.1fx)\n", automatedNs, perSampleNs/automatedNs);
+    return 0;
+}
@@ -0,0 +1,236 @@
+/*
+  ==============================================================================
+
+    StartupBenchmark.cpp
+
+    Measures what a session load pays per instance: constructing an engine,
+    preparing it and processing its first block, for N instances kept alive
+    side by side, both with the delay lines reserved up front (as the plugin
+    does) and allocated lazily by the first prepare. Then re-prepares one
+    reserved engine across every rate, channel count, comb engine and eco
+    mode within its limits, and fails if any of those prepares or the blocks
+    after them allocate.
+
+    startup_benchmark [--instances <n>] [--quick] [--json <path>]
+
+  ==============================================================================
+*/
+
+#include "DSP/MoorerReverbEngine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace
+{
+    std::atomic<long> numAllocations {0};
+}
+
+// every heap allocation in the process goes through these
+void* operator new(std::size_t size)
+{
+    numAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(std::max<std::size_t>(size, 1)))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+
+namespace
+{
+    constexpr double maxSampleRate = 96000.0;
+    constexpr int blockSize = 512;
+
+    using Clock = std::chrono::steady_clock;
+
+    double microsecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    }
+
+    struct Phase
+    {
+        double total {0.0}, worst {0.0};
+        long allocations {0};
+
+        template <typename Function>
+        void time(Function&& f)
+        {
+            const long before = numAllocations.load();
+            const auto start = Clock::now();
+            f();
+            const double elapsed = microsecondsSince(start);
+            allocations += numAllocations.load() - before;
+            total += elapsed;
+            worst = std::max(worst, elapsed);
+        }
+    };
+
+    struct Startup
+    {
+        const char* name;
+        Phase construct, prepare, firstBlock;
+    };
+
+    /* n instances at 48k stereo, configured the way the plugin configures them */
+    Startup measureStartup(const char* name, bool reserve, int numInstances)
+    {
+        Startup startup { name, {}, {}, {} };
+        std::vector<std::unique_ptr<MoorerReverbEngine>> engines;
+        engines.reserve((size_t)numInstances);
+
+        std::vector<float> left(blockSize, 0.0f), right(blockSize, 0.0f);
+        left[0] = right[0] = 1.0f;
+
+        for (int i = 0; i < numInstances; ++i) {
+            startup.construct.time([&] {
+                engines.push_back(std::make_unique<MoorerReverbEngine>());
+                if (reserve)
+                    engines.back()->reserve(maxSampleRate, 2);
+            });
+            startup.prepare.time([&] { engines.back()->prepare(48000.0, 2); });
+
+            float* channels[2] = { left.data(), right.data() };
+            startup.firstBlock.time([&] { engines.back()->process(channels, 2, blockSize); });
+        }
+        return startup;
+    }
+
+    struct Reprepare
+    {
+        int numPrepares {0};
+        Phase prepare, process;
+    };
+
+    /* every prepare a host could ask for within the reserved limits, in an
+       order that keeps changing the rate and the layout */
+    Reprepare measureReprepare(int rounds)
+    {
+        Reprepare result;
+        MoorerReverbEngine engine;
+        engine.reserve(maxSampleRate, 2);
+
+        std::vector<float> left(blockSize, 0.5f), right(blockSize, -0.5f);
+        float* channels[2] = { left.data(), right.data() };
+
+        for (int round = 0; round < rounds; ++round) {
+            for (const double sampleRate : { 44100.0, 96000.0, 48000.0, 88200.0, 22050.0 }) {
+                for (const int numChannels : { 2, 1 }) {
+                    for (const auto combEngine : { MoorerReverbEngine::CombEngine::scalar, MoorerReverbEngine::CombEngine::simd }) {
+                        for (const bool interleave : { false, true }) {
+                            for (const int decimation : { 1, 2, 4 }) {
+                                engine.setCombEngine(combEngine);
+                                engine.setInterleaveChannels(interleave);
+                                engine.setDecimation(decimation);
+
+                                result.prepare.time([&] { engine.prepare(sampleRate, numChannels); });
+                                result.process.time([&] { engine.process(channels, numChannels, blockSize); });
+                                ++result.numPrepares;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+    void printPhase(const char* name, const Phase& phase, int count)
+    {
+        std::printf("  %-12s %10.2f us mean %10.2f us worst %8.2f allocations each\n",
+                    name, phase.total/count, phase.worst, (double)phase.allocations/count);
+    }
+
+    void writePhase(FILE* file, const char* name, const Phase& phase, int count, bool last)
+    {
+        std::fprintf(file, "      \"%s\": { \"mean_us\": %.3f, \"worst_us\": %.3f, \"allocations\": %ld }%s\n",
+                     name, phase.total/count, phase.worst, phase.allocations, last ? "" : ",");
+    }
+
+    bool writeJson(const char* path, const std::vector<Startup>& startups, int numInstances, const Reprepare& reprepare)
+    {
+        FILE* file = std::fopen(path, "w");
+        if (file == nullptr)
+            return false;
+
+        std::fprintf(file, "{\n  \"instances\": %d,\n  \"max_sample_rate\": %g,\n  \"startup\": [\n", numInstances, maxSampleRate);
+        for (size_t i = 0; i < startups.size(); ++i) {
+            const auto& s = startups[i];
+            std::fprintf(file, "    {\n      \"variant\": \"%s\",\n", s.name);
+            writePhase(file, "construct", s.construct, numInstances, false);
+            writePhase(file, "prepare", s.prepare, numInstances, false);
+            writePhase(file, "first_block", s.firstBlock, numInstances, true);
+            std::fprintf(file, "    }%s\n", i + 1 < startups.size() ? "," : "");
+        }
+        std::fprintf(file, "  ],\n  \"reprepare\": {\n    \"count\": %d,\n", reprepare.numPrepares);
+        writePhase(file, "prepare", reprepare.prepare, reprepare.numPrepares, false);
+        writePhase(file, "process", reprepare.process, reprepare.numPrepares, true);
+        std::fprintf(file, "  }\n}\n");
+        std::fclose(file);
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int numInstances = 256;
+    int rounds = 4;
+    const char* jsonPath = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            numInstances = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--quick") == 0) {
+            numInstances = std::min(numInstances, 16);
+            rounds = 1;
+        } else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else {
+            std::fprintf(stderr, "usage: %s [--instances <n>] [--quick] [--json <path>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<Startup> startups;
+    startups.push_back(measureStartup("reserved", true, numInstances));
+    startups.push_back(measureStartup("lazy", false, numInstances));
+
+    std::printf("%d instances, 48k stereo, %d-sample first block\n", numInstances, blockSize);
+    for (const auto& s : startups) {
+        const double total = (s.construct.total + s.prepare.total + s.firstBlock.total)/numInstances;
+        std::printf("%s: %.2f us per instance\n", s.name, total);
+        printPhase("construct", s.construct, numInstances);
+        printPhase("prepare", s.prepare, numInstances);
+        printPhase("first block", s.firstBlock, numInstances);
+    }
+
+    const Reprepare reprepare = measureReprepare(rounds);
+    std::printf("re-prepare within %g Hz stereo: %d prepares\n", maxSampleRate, reprepare.numPrepares);
+    printPhase("prepare", reprepare.prepare, reprepare.numPrepares);
+    printPhase("process", reprepare.process, reprepare.numPrepares);
+
+    if (jsonPath != nullptr && ! writeJson(jsonPath, startups, numInstances, reprepare)) {
+        std::fprintf(stderr, "couldn't write %s\n", jsonPath);
+        return 1;
+    }
+
+    if (reprepare.prepare.allocations + reprepare.process.allocations != 0) {
+        std::fprintf(stderr, "re-preparing within the reserved limits allocated %ld times\n",
+                     reprepare.prepare.allocations + reprepare.process.allocations);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+/*
+  ==============================================================================
+
+    CpuLoadMeter.h
+
+    Times each processBlock call against its deadline (numSamples/sampleRate).
+    The audio thread pushes one record per block into a lock-free FIFO; the
+    message thread drains it into a window of recent blocks and works out the
+    mean, 99th percentile and worst case from there.
+
+    Build with MOORER_CPU_LOAD_METER=0 to compile the meter out entirely.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#ifndef MOORER_CPU_LOAD_METER
+ #define MOORER_CPU_LOAD_METER 1
+#endif
+
+#if MOORER_CPU_LOAD_METER
+
+#include <JuceHeader.h>
+
+class CpuLoadMeter
+{
+public:
+    /* loads are fractions of the block deadline, times are in microseconds */
+    struct Stats
+    {
+        int numBlocks {0};
+        float meanLoad {0.0f}, p99Load {0.0f}, maxLoad {0.0f};
+        float meanMicroseconds {0.0f}, maxMicroseconds {0.0f};
+    };
+
+    /* call while the audio thread is stopped, i.e. from prepareToPlay() */
+    void prepare(double newSampleRate) { sampleRate = newSampleRate; }
+
+    /* times its own lifetime on the audio thread */
+    class ScopedBlock
+    {
+    public:
+        ScopedBlock(CpuLoadMeter& meterToUse, int numSamplesToProcess)
+            : meter(meterToUse), numSamples(numSamplesToProcess), start(juce::Time::getHighResolutionTicks()) {}
+
+        ~ScopedBlock() { meter.push(juce::Time::getHighResolutionTicks() - start, numSamples); }
+
+    private:
+        CpuLoadMeter& meter;
+        int numSamples;
+        juce::int64 start;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedBlock)
+    };
+
+    /* message thread only: takes in whatever the audio thread has pushed
+       since the last call and summarises the last windowSize blocks */
+    Stats getStats()
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+        auto take = [this](int start, int size) {
+            for (int i = start; i < start + size; ++i) {
+                history[(size_t)historyWrite] = records[(size_t)i];
+                historyWrite = (historyWrite + 1) % windowSize;
+                historySize = juce::jmin(historySize + 1, windowSize);
+            }
+        };
+        take(start1, size1);
+        take(start2, size2);
+        fifo.finishedRead(size1 + size2);
+
+        Stats stats;
+        stats.numBlocks = historySize;
+        if (historySize == 0)
+            return stats;
+
+        for (int i = 0; i < historySize; ++i) {
+            const auto& record = history[(size_t)i];
+            loads[(size_t)i] = record.load;
+            stats.meanLoad += record.load;
+            stats.meanMicroseconds += record.microseconds;
+            stats.maxLoad = juce::jmax(stats.maxLoad, record.load);
+            stats.maxMicroseconds = juce::jmax(stats.maxMicroseconds, record.microseconds);
+        }
+        stats.meanLoad /= (float)historySize;
+        stats.meanMicroseconds /= (float)historySize;
+
+        const int p99 = juce::jmin(historySize - 1, (int)(0.99f*(float)historySize));
+        std::nth_element(loads.begin(), loads.begin() + p99, loads.begin() + historySize);
+        stats.p99Load = loads[(size_t)p99];
+
+        return stats;
+    }
+
+private:
+    struct Record
+    {
+        float load {0.0f}, microseconds {0.0f};
+    };
+
+    static constexpr int fifoSize = 1024;
+    static constexpr int windowSize = 512;
+
+    double sampleRate {44100.0};
+
+    // audio thread -> message thread; blocks are dropped while nobody is reading
+    juce::AbstractFifo fifo {fifoSize};
+    std::array<Record, fifoSize> records;
+
+    // message thread only
+    std::array<Record, windowSize> history;
+    std::array<float, windowSize> loads;
+    int historyWrite {0}, historySize {0};
+
+    void push(juce::int64 ticks, int numSamples)
+    {
+        if (numSamples <= 0)
+            return;
+
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(1, start1, size1, start2, size2);
+        if (size1 == 0)
+            return;
+
+        const double seconds = juce::Time::highResolutionTicksToSeconds(ticks);
+        records[(size_t)start1] = { (float)(seconds*sampleRate/(double)numSamples), (float)(seconds*1.0e6) };
+        fifo.finishedWrite(1);
+    }
+};
+
+#endif
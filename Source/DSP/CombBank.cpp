@@ -0,0 +1,156 @@
+/*
+  ==============================================================================
+
+    CombBank.cpp
+
+  ==============================================================================
+*/
+
+#include "CombBank.h"
+
+#include <cstring>
+
+// a fused multiply-add on one side only would break bit-compatibility with the scalar combs
+// (GCC has no pragma for this; the builds pass -ffp-contract=off instead)
+#if defined(__clang__)
+ #pragma clang fp contract(off)
+#endif
+
+//==============================================================================
+bool CombBank::hasSimdKernel()
+{
+   #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+    return true;
+   #else
+    return DspKernels::best().isa != DspKernels::Isa::baseline;
+   #endif
+}
+
+void CombBank::prepare(const int* newDelays, const float* newCoefficients, int newNumCombs, int newNumChannels, int maxBlockSize,
+                       DelayLineArena& arena)
+{
+    numCombs = std::min(newNumCombs, maxCombs);
+    numChannels = newNumChannels;
+    frameWidth = maxCombs*numChannels;
+
+    int longestDelay = 0;
+    coefficients.assign((size_t)frameWidth, 0.0f);
+    for (int i = 0; i < maxCombs; i++) {
+        for (int c = 0; c < numChannels; ++c) {
+            const int lane = i*numChannels + c;
+            delays[lane] = i < numCombs ? newDelays[lane] : 0;
+            coefficients[(size_t)lane] = i < numCombs ? newCoefficients[i] : 0.0f;
+            longestDelay = std::max(longestDelay, delays[lane]);
+        }
+    }
+
+    // outputs land up to longestDelay frames ahead and the frame behind is still read
+    arena.add(frames, longestDelay + 2, frameWidth);
+    inputFrames.assign((size_t)maxBlockSize*(size_t)frameWidth, 0.0f);
+}
+
+void CombBank::reset()
+{
+    frames.clear();
+}
+
+void CombBank::process(const DelayLine& input, DelayLine& output, uint32_t position, int numSamples,
+                       float reverbTime, float damping, const float* reverbTimes, const float* dampings)
+{
+    switch (numChannels) {
+        case 8:  processChannels<8>(input, output, position, numSamples, reverbTime, damping, reverbTimes, dampings); break;
+        case 4:  processChannels<4>(input, output, position, numSamples, reverbTime, damping, reverbTimes, dampings); break;
+        case 2:  processChannels<2>(input, output, position, numSamples, reverbTime, damping, reverbTimes, dampings); break;
+        default: processChannels<1>(input, output, position, numSamples, reverbTime, damping, reverbTimes, dampings); break;
+    }
+}
+
+template <int channels>
+void CombBank::processChannels(const DelayLine& input, DelayLine& output, uint32_t position, int numSamples,
+                               float reverbTime, float damping, const float* reverbTimes, const float* dampings)
+{
+    gatherInput<channels>(input, position, numSamples);
+
+    if (forceScalar || ! hasSimdKernel())
+        processScalar<channels>(output, position, numSamples, reverbTime, damping, reverbTimes, dampings);
+    else
+        processSimd<channels>(output, position, numSamples, reverbTime, damping, reverbTimes, dampings);
+}
+
+template <int channels>
+void CombBank::gatherInput(const DelayLine& input, uint32_t position, int numSamples)
+{
+    constexpr int width = maxCombs*channels;
+
+    const int numLanes = numCombs*channels;
+    const float* sources[width];
+
+    // each lane reads its own channel its own delay back; frames are filled in
+    // order, a stretch over which none of the reads wraps at a time
+    for (int done = 0; done < numSamples;) {
+        int run = numSamples - done;
+        for (int lane = 0; lane < numLanes; ++lane) {
+            const uint32_t dpr = position + (uint32_t)done - (uint32_t)delays[lane];
+            run = std::min(run, input.contiguous(dpr));
+            sources[lane] = input.at(dpr) + lane % channels;
+        }
+
+        for (int k = 0; k < run; ++k) {
+            float* frame = inputFrames.data() + (size_t)(done + k)*width;
+            for (int lane = 0; lane < numLanes; ++lane)
+                frame[lane] = sources[lane][k*channels];
+        }
+        done += run;
+    }
+}
+
+template <int channels>
+void CombBank::scatterOutput(const float* y, DelayLine& output, uint32_t position)
+{
+    float combSum[channels] {};
+
+    // the sum runs in comb order so it matches the scalar combs bit for bit
+    for (int i = 0; i < numCombs; i++) {
+        for (int c = 0; c < channels; ++c) {
+            const int lane = i*channels + c;
+            frameAt(position + (uint32_t)delays[lane])[lane] = y[lane];
+            combSum[c] += y[lane];
+        }
+    }
+
+    float* out = output.at(position);
+    for (int c = 0; c < channels; ++c)
+        out[c] = combSum[c];
+}
+
+//==============================================================================
+template <int channels>
+void CombBank::processScalar(DelayLine& output, uint32_t position, int numSamples,
+                             float reverbTime, float damping, const float* reverbTimes, const float* dampings)
+{
+    constexpr int width = maxCombs*channels;
+    float y[width];
+
+    for (int k = 0; k < numSamples; ++k) {
+        const uint32_t dpw = position + (uint32_t)k;
+        const float rt = reverbTimes != nullptr ? reverbTimes[k] : reverbTime;
+        const float d = dampings != nullptr ? dampings[k] : damping;
+        const float* xd = inputFrames.data() + (size_t)k*width;
+        const float* fb = frameAt(dpw);
+        const float* fbPrev = frameAt(dpw - 1);
+
+        for (int lane = 0; lane < numCombs*channels; ++lane) {
+            const float g = d*coefficients[(size_t)lane];
+            y[lane] = rt*(xd[lane] + (1 - g)*(fb[lane] + g*fbPrev[lane]));
+        }
+        scatterOutput<channels>(y, output, dpw);
+    }
+}
+
+template <int channels>
+void CombBank::processSimd(DelayLine& output, uint32_t position, int numSamples,
+                           float reverbTime, float damping, const float* reverbTimes, const float* dampings)
+{
+    kernels->combFrames({ &frames, &output, inputFrames.data(), coefficients.data(), delays, numCombs, channels,
+                          position, numSamples, reverbTime, damping, reverbTimes, dampings });
+}
@@ -0,0 +1,75 @@
+/*
+  ==============================================================================
+
+    CombBank.h
+
+    The six lowpass-feedback combs stored structure-of-arrays, so that one
+    vector operation steps every comb at once. Each frame of the ring holds
+    one sample per comb (padded to 8 lanes), and each lane writes its output
+    its own delay ahead of the current position: the frame at position t
+    then holds y[t - delay] for every lane, so the feedback reads are two
+    plain vector loads and only the writes are per lane.
+
+    With interleaved input each comb gets a lane per channel (up to
+    maxChannels), giving frames laid out comb by comb. Since only the writes
+    depend on the delay, every channel's combs can have delays of their own.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "DelayLineArena.h"
+#include "DspKernels.h"
+
+#include <vector>
+
+class CombBank
+{
+public:
+    static constexpr int maxCombs = 8;
+    static constexpr int maxChannels = 8;
+
+    /* steps the frames with the vector kernel from kernels when there is one
+       (SSE/NEON or wider), otherwise (or when forced) a scalar loop over the
+       lanes doing the same arithmetic */
+    static bool hasSimdKernel();
+    void setForceScalar(bool shouldForceScalar) { forceScalar = shouldForceScalar; }
+    void setKernels(const DspKernels& newKernels) { kernels = &newKernels; }
+
+    /* numChannels is the number of interleaved lanes of the input line (1, 2,
+       4 or 8), and delays holds numCombs*numChannels delays, comb by comb;
+       the ring of frames is added to arena, and is ready once it's allocated */
+    void prepare(const int* delays, const float* coefficients, int numCombs, int numChannels, int maxBlockSize,
+                 DelayLineArena& arena);
+    void reset();
+
+    /* runs the combs over numSamples frames of input starting at position and
+       writes their sum into output; reverbTimes/dampings override the scalar
+       values per frame when not null */
+    void process(const DelayLine& input, DelayLine& output, uint32_t position, int numSamples,
+                 float reverbTime, float damping, const float* reverbTimes, const float* dampings);
+
+private:
+    int numCombs {0}, numChannels {1}, frameWidth {maxCombs};
+    int delays[maxCombs*maxChannels] {};   // one per lane
+    std::vector<float> coefficients;    // one per lane
+    bool forceScalar {false};
+    const DspKernels* kernels {&DspKernels::best()};
+
+    DelayLine frames;                   // ring of frameWidth-wide frames
+
+    std::vector<float> inputFrames;     // the delayed input for one chunk, one frame per sample
+
+    float* frameAt(uint32_t position) { return frames.at(position); }
+
+    /* specialised on the channel count so the per-lane loops unroll */
+    template <int channels> void gatherInput(const DelayLine& input, uint32_t position, int numSamples);
+    template <int channels> void scatterOutput(const float* y, DelayLine& output, uint32_t position);
+    template <int channels> void processScalar(DelayLine& output, uint32_t position, int numSamples,
+                                               float reverbTime, float damping, const float* reverbTimes, const float* dampings);
+    template <int channels> void processSimd(DelayLine& output, uint32_t position, int numSamples,
+                                             float reverbTime, float damping, const float* reverbTimes, const float* dampings);
+    template <int channels> void processChannels(const DelayLine& input, DelayLine& output, uint32_t position, int numSamples,
+                                                 float reverbTime, float damping, const float* reverbTimes, const float* dampings);
+};
@@ -0,0 +1,92 @@
+/*
+  ==============================================================================
+
+    DelayLine.h
+
+    Power-of-two ring buffer used for every delay line in the reverb. Reads
+    and writes wrap with a mask rather than a modulo, and positions are plain
+    unsigned counters that are allowed to overflow (the mask keeps them in
+    range since the length always divides 2^32).
+
+    A line can hold several lanes per sample (e.g. interleaved L/R frames),
+    in which case positions, lengths and delays all count frames.
+
+    Lines don't own their memory: a DelayLineArena hands each one a region of
+    a single block, and a line that was never given one has length zero.
+
+    Templated on the sample type for the double-precision engine; DelayLine
+    is the float one everything else uses.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+template <typename SampleType>
+class BasicDelayLine
+{
+public:
+    /* minimumLength frames rounded up to a power of two */
+    static int lengthFor(int minimumLength)
+    {
+        int length = 1;
+        while (length < minimumLength)
+            length <<= 1;
+        return length;
+    }
+
+    void clear() { std::fill(buffer, buffer + (size_t)length*(size_t)lanes, SampleType(0)); }
+
+    int getSize() const  { return length; }
+    int getNumLanes() const { return lanes; }
+    uint32_t getMask() const { return mask; }
+
+    SampleType* at(uint32_t position)             { return buffer + (size_t)(position & mask)*(size_t)lanes; }
+    const SampleType* at(uint32_t position) const { return buffer + (size_t)(position & mask)*(size_t)lanes; }
+
+    /* number of frames that can be accessed from position before the buffer wraps */
+    int contiguous(uint32_t position) const { return (int)(mask - (position & mask)) + 1; }
+
+    /* copies numFrames frames from position onwards into destination, unwrapped */
+    void read(uint32_t position, int numFrames, SampleType* destination) const
+    {
+        for (int done = 0; done < numFrames;) {
+            const int run = std::min(numFrames - done, contiguous(position));
+            std::copy(at(position), at(position) + run*lanes, destination + done*lanes);
+            position += (uint32_t)run;
+            done += run;
+        }
+    }
+
+    /* linearly interpolated read, delay frames behind position */
+    SampleType readFractional(uint32_t position, float delay, int lane = 0) const
+    {
+        const int whole = (int)delay;
+        const SampleType fraction = delay - (float)whole;
+        const SampleType a = at(position - (uint32_t)whole)[lane];
+        const SampleType b = at(position - (uint32_t)whole - 1)[lane];
+        return a + fraction*(b - a);
+    }
+
+private:
+    friend class DelayLineArena;
+
+    SampleType* buffer {nullptr};
+    int length {0};
+    uint32_t mask {0};
+    int lanes {1};
+
+    /* memory must hold newLength*numLanes samples, newLength a power of two */
+    void attach(SampleType* memory, int newLength, int numLanes)
+    {
+        buffer = memory;
+        length = newLength;
+        mask = (uint32_t)(newLength - 1);
+        lanes = numLanes;
+    }
+};
+
+using DelayLine = BasicDelayLine<float>;
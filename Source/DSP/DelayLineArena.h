@@ -0,0 +1,132 @@
+/*
+  ==============================================================================
+
+    DelayLineArena.h
+
+    One cache-aligned block holding every delay line of an engine. Lines are
+    added in the order the processing touches them, each with the length it
+    actually needs, and allocate() lays them out back to back with every
+    region starting on a cache line. The block is only reallocated when a
+    layout needs more room than it already has, and reserve() can make it
+    big enough for every layout up front.
+
+    The block is raw storage counted in bytes; attaching a line creates its
+    samples, float or double, in its region, so each region is only ever
+    accessed as the type living there.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "DelayLine.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+class DelayLineArena
+{
+public:
+    static constexpr size_t alignment = 64;     // bytes
+
+    /* starts a new layout; lines keep their old regions until allocate() */
+    void beginLayout() { entries.clear(); }
+
+    /* reserves minimumLength frames of numLanes lanes for line, rounded up to
+       a power of two; lines of either sample type can share the block */
+    template <typename SampleType>
+    void add(BasicDelayLine<SampleType>& line, int minimumLength, int numLanes = 1)
+    {
+        static_assert(alignof(SampleType) <= alignment, "every region starts on a cache line");
+        entries.push_back({ &line, &attachLine<SampleType>, BasicDelayLine<SampleType>::lengthFor(minimumLength), numLanes,
+                            numLanes*(int)sizeof(SampleType) });
+    }
+
+    /* bytes the lines added since beginLayout() take up */
+    size_t getLayoutSize() const
+    {
+        size_t total = 0;
+        for (auto& entry : entries)
+            total += regionSize(entry);
+        return total;
+    }
+
+    /* makes room up front, so allocating a layout of up to numBytes doesn't
+       allocate again */
+    void reserve(size_t numBytes)
+    {
+        if (numBytes + alignment > capacity) {
+            // left uninitialised; clear() only touches what a layout uses
+            capacity = numBytes + alignment;
+            storage.reset(new std::byte[capacity]);
+        }
+        base = aligned(storage.get());
+    }
+
+    /* points every line added since beginLayout() at its region; call clear()
+       before reading them */
+    void allocate()
+    {
+        size = getLayoutSize();
+        reserve(size);
+
+        std::byte* region = base;
+        for (auto& entry : entries) {
+            entry.attach(entry.line, region, entry.length, entry.lanes);
+            region += regionSize(entry);
+        }
+    }
+
+    // all-zero bytes are 0 in float and double alike
+    void clear() { std::memset(base, 0, size); }
+
+    /* the part of the block the current layout uses, as bytes */
+    size_t getNumBytes() const { return size; }
+    std::byte* getData() { return base; }
+    const std::byte* getData() const { return base; }
+
+private:
+    struct Entry
+    {
+        void* line;
+        void (*attach)(void* line, std::byte* memory, int length, int lanes);
+        int length, lanes;
+        int bytesPerFrame;
+    };
+
+    /* starts the lifetime of the region's samples as SampleType, ending that
+       of whatever a previous layout put there; their values are left for
+       clear() to set */
+    template <typename SampleType>
+    static void attachLine(void* line, std::byte* memory, int length, int lanes)
+    {
+        const size_t count = (size_t)length*(size_t)lanes;
+        for (size_t i = 0; i < count; ++i)
+            ::new (static_cast<void*>(memory + i*sizeof(SampleType))) SampleType;
+        static_cast<BasicDelayLine<SampleType>*>(line)->attach(std::launder(reinterpret_cast<SampleType*>(memory)),
+                                                               length, lanes);
+    }
+
+    std::vector<Entry> entries;
+    std::unique_ptr<std::byte[]> storage;
+    size_t capacity {0};
+    std::byte* base {nullptr};
+    size_t size {0};
+
+    static size_t regionSize(const Entry& entry)
+    {
+        const size_t bytes = (size_t)entry.length*(size_t)entry.bytesPerFrame;
+        return (bytes + alignment - 1)/alignment*alignment;
+    }
+
+    static std::byte* aligned(std::byte* memory)
+    {
+        const auto address = reinterpret_cast<uintptr_t>(memory);
+        return memory + (((address + alignment - 1) & ~(uintptr_t)(alignment - 1)) - address);
+    }
+};
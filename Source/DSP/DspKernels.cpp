@@ -0,0 +1,89 @@
+/*
+  ==============================================================================
+
+    DspKernels.cpp
+
+    Picks the variant, and builds the baseline one with whatever the rest of
+    the code is compiled for.
+
+  ==============================================================================
+*/
+
+#include "DspKernels.h"
+#include "CombBank.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__AVX__)
+ #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+ #include <arm_neon.h>
+#endif
+
+// a fused multiply-add in one variant only would break bit-compatibility between them
+// (GCC has no pragma for this; the builds pass -ffp-contract=off instead)
+#if defined(__clang__)
+ #pragma clang fp contract(off)
+#endif
+
+#define MOORER_KERNEL_ISA DspKernels::Isa::baseline
+#include "DspKernelsImpl.h"
+
+//==============================================================================
+const DspKernels& DspKernels::baselineKernels()
+{
+    return kernelTable;
+}
+
+const char* DspKernels::getIsaName(Isa isa)
+{
+    switch (isa) {
+       #if MOORER_KERNELS_X86 || defined(_M_X64)
+        case Isa::baseline: return "sse2";
+       #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+        case Isa::baseline: return "neon";
+       #else
+        case Isa::baseline: return "baseline";
+       #endif
+        case Isa::avx2:     return "avx2";
+        case Isa::avx512:   return "avx512";
+    }
+    return "unknown";
+}
+
+const DspKernels* DspKernels::forIsa(Isa isa)
+{
+   #if MOORER_KERNELS_X86
+    __builtin_cpu_init();
+    if (isa == Isa::avx512 && __builtin_cpu_supports("avx512f"))
+        return &avx512Kernels();
+    if (isa == Isa::avx2 && __builtin_cpu_supports("avx2"))
+        return &avx2Kernels();
+   #endif
+    return isa == Isa::baseline ? &baselineKernels() : nullptr;
+}
+
+const DspKernels& DspKernels::best()
+{
+    static const DspKernels& chosen = [] () -> const DspKernels& {
+        // "baseline" or "sse2" both name the baseline
+        if (const char* forced = std::getenv("MOORER_ISA")) {
+            for (int i = 0; i < numIsas; ++i) {
+                const auto isa = (Isa)i;
+                if (std::strcmp(forced, getIsaName(isa)) == 0 || (isa == Isa::baseline && std::strcmp(forced, "baseline") == 0))
+                    if (const DspKernels* kernels = forIsa(isa))
+                        return *kernels;
+            }
+        }
+
+        for (int i = numIsas - 1; i > 0; --i)
+            if (const DspKernels* kernels = forIsa((Isa)i))
+                return *kernels;
+        return baselineKernels();
+    }();
+
+    return chosen;
+}
@@ -0,0 +1,101 @@
+/*
+  ==============================================================================
+
+    DspKernels.h
+
+    The innermost loops of the engine (FIR taps, combs, comb bank, allpass,
+    mix), compiled once per instruction set and reached through a table of
+    function pointers. Each kernel works on one contiguous run of a delay
+    line, so the indirect call is paid once per run rather than per sample.
+
+    Every variant does the same arithmetic in the same order, so they all
+    give bit-identical output; only the vector width differs. The widest one
+    the CPU supports is picked from CPUID the first time it's asked for, and
+    MOORER_ISA=baseline|avx2|avx512 in the environment forces a narrower one.
+
+    The AVX2 and AVX-512 variants are only built by GCC and Clang on x86;
+    everywhere else baseline (SSE2 on x86-64, NEON on ARM) is all there is.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "DelayLine.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+ #define MOORER_KERNELS_X86 1
+#else
+ #define MOORER_KERNELS_X86 0
+#endif
+
+struct DspKernels
+{
+    enum class Isa { baseline, avx2, avx512 };
+    static constexpr int numIsas = 3;
+
+    static const char* getIsaName(Isa isa);
+
+    /* the variant used unless one is forced: the widest this CPU runs, or
+       the one MOORER_ISA names if it runs here */
+    static const DspKernels& best();
+
+    /* nullptr if the variant wasn't compiled in or this CPU can't run it */
+    static const DspKernels* forIsa(Isa isa);
+
+    /* one run of CombBank frames: the per-lane coefficients and delays, and
+       a frame of delayed input per sample */
+    struct CombFrames
+    {
+        DelayLine* frames;
+        DelayLine* output;
+        const float* input;
+        const float* coefficients;
+        const int* delays;
+        int numCombs, channels;
+        uint32_t position;
+        int numSamples;
+        float reverbTime, damping;
+        const float* reverbTimes;       // per frame when not null
+        const float* dampings;
+    };
+
+    Isa isa;
+
+    /* out += gain*in */
+    void (*multiplyAdd)(float* out, const float* in, float gain, int numSamples);
+
+    /* out += in */
+    void (*add)(float* out, const float* in, int numSamples);
+
+    /* out = rt*(xd + lowpass*(fb + feedback*fbPrev)) */
+    void (*comb)(float* out, const float* xd, const float* fb, const float* fbPrev,
+                 float rt, float lowpass, float feedback, int numSamples);
+
+    /* the same while reverb time and damping glide: over numFrames frames of
+       lanes (1, 2, 4 or 8) interleaved samples, out = rt*(xd + (1-g)*(fb +
+       g*fbPrev)) with rt = rts[k] and g = dampings[k]*coefficient for frame k */
+    void (*combRamped)(float* out, const float* xd, const float* fb, const float* fbPrev,
+                       const float* rts, const float* dampings, float coefficient, int lanes, int numFrames);
+
+    /* out = -gain*x + xd + gain*yd */
+    void (*allpass)(float* out, const float* x, const float* xd, const float* yd, float gain, int numSamples);
+
+    /* out = dry*out + wet*(gain*(early + late)), early and late interleaved
+       by one or two lanes */
+    void (*mixMono)(float* out, const float* early, const float* late,
+                    float dry, float wet, float gain, int numSamples);
+    void (*mixStereo)(float* left, float* right, const float* early, const float* late,
+                      float dry, float wet, float gain, int numSamples);
+
+    /* steps every comb of a CombBank once per frame */
+    void (*combFrames)(const CombFrames& run);
+
+private:
+    /* each in its own translation unit, compiled for its instruction set */
+    static const DspKernels& baselineKernels();
+   #if MOORER_KERNELS_X86
+    static const DspKernels& avx2Kernels();
+    static const DspKernels& avx512Kernels();
+   #endif
+};
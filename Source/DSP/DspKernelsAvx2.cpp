@@ -0,0 +1,43 @@
+/*
+  ==============================================================================
+
+    DspKernelsAvx2.cpp
+
+    The AVX2 variant of the kernels, built for that target whatever the rest
+    of the code is compiled for; DspKernels only hands it out on CPUs that
+    have it. FMA is left off, the other variants don't have it.
+
+  ==============================================================================
+*/
+
+#include "DspKernels.h"
+#include "CombBank.h"
+
+#if MOORER_KERNELS_X86
+
+#include <immintrin.h>
+
+#if defined(__clang__)
+ #pragma clang fp contract(off)
+ #pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#else
+ #pragma GCC push_options
+ #pragma GCC target("avx2")
+#endif
+
+#define MOORER_KERNEL_ISA DspKernels::Isa::avx2
+#define MOORER_KERNEL_AVX2 1
+#include "DspKernelsImpl.h"
+
+#if defined(__clang__)
+ #pragma clang attribute pop
+#else
+ #pragma GCC pop_options
+#endif
+
+const DspKernels& DspKernels::avx2Kernels()
+{
+    return kernelTable;
+}
+
+#endif
@@ -0,0 +1,43 @@
+/*
+  ==============================================================================
+
+    DspKernelsAvx512.cpp
+
+    The AVX-512 variant: interleaved stereo comb banks step all sixteen lanes
+    in one vector. Only AVX-512F is assumed, and DspKernels only hands this
+    out on CPUs that report it.
+
+  ==============================================================================
+*/
+
+#include "DspKernels.h"
+#include "CombBank.h"
+
+#if MOORER_KERNELS_X86
+
+#include <immintrin.h>
+
+#if defined(__clang__)
+ #pragma clang fp contract(off)
+ #pragma clang attribute push (__attribute__((target("avx512f"))), apply_to = function)
+#else
+ #pragma GCC push_options
+ #pragma GCC target("avx512f")
+#endif
+
+#define MOORER_KERNEL_ISA DspKernels::Isa::avx512
+#define MOORER_KERNEL_AVX512 1
+#include "DspKernelsImpl.h"
+
+#if defined(__clang__)
+ #pragma clang attribute pop
+#else
+ #pragma GCC pop_options
+#endif
+
+const DspKernels& DspKernels::avx512Kernels()
+{
+    return kernelTable;
+}
+
+#endif
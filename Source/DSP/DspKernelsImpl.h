@@ -0,0 +1,194 @@
+/*
+  ==============================================================================
+
+    DspKernelsImpl.h
+
+    The kernel bodies behind DspKernels, included once by each variant's
+    translation unit after the headers it needs and after it has switched the
+    compiler to its instruction set. Everything here is in an anonymous
+    namespace, so each inclusion gets its own copies compiled for its own
+    target; nothing here may include a header, or inline code compiled for
+    a wider target could end up shared with the baseline.
+
+    Before including it, define MOORER_KERNEL_ISA to the DspKernels::Isa
+    being built, and MOORER_KERNEL_AVX2 or MOORER_KERNEL_AVX512 for the
+    x86 variants.
+
+  ==============================================================================
+*/
+
+namespace
+{
+    void multiplyAdd(float* out, const float* in, float gain, int numSamples)
+    {
+        for (int k = 0; k < numSamples; ++k)
+            out[k] += gain*in[k];
+    }
+
+    void add(float* out, const float* in, int numSamples)
+    {
+        for (int k = 0; k < numSamples; ++k)
+            out[k] += in[k];
+    }
+
+    void comb(float* out, const float* xd, const float* fb, const float* fbPrev,
+              float rt, float lowpass, float feedback, int numSamples)
+    {
+        for (int k = 0; k < numSamples; ++k)
+            out[k] = rt*(xd[k] + lowpass*(fb[k] + feedback*fbPrev[k]));
+    }
+
+    /* the frame's gains broadcast over its lanes; with one lane this is a
+       plain loop along time, with more the lane loop is one vector */
+    template <int lanes>
+    void combRampedFor(float* out, const float* xd, const float* fb, const float* fbPrev,
+                       const float* rts, const float* dampings, float coefficient, int numFrames)
+    {
+        for (int k = 0; k < numFrames; ++k) {
+            const float rt = rts[k];
+            const float g = dampings[k]*coefficient;
+            for (int c = 0; c < lanes; ++c) {
+                const int j = k*lanes + c;
+                out[j] = rt*(xd[j] + (1 - g)*(fb[j] + g*fbPrev[j]));
+            }
+        }
+    }
+
+    void combRamped(float* out, const float* xd, const float* fb, const float* fbPrev,
+                    const float* rts, const float* dampings, float coefficient, int lanes, int numFrames)
+    {
+        switch (lanes) {
+            case 8:  combRampedFor<8>(out, xd, fb, fbPrev, rts, dampings, coefficient, numFrames); break;
+            case 4:  combRampedFor<4>(out, xd, fb, fbPrev, rts, dampings, coefficient, numFrames); break;
+            case 2:  combRampedFor<2>(out, xd, fb, fbPrev, rts, dampings, coefficient, numFrames); break;
+            default: combRampedFor<1>(out, xd, fb, fbPrev, rts, dampings, coefficient, numFrames); break;
+        }
+    }
+
+    void allpass(float* out, const float* x, const float* xd, const float* yd, float gain, int numSamples)
+    {
+        for (int k = 0; k < numSamples; ++k)
+            out[k] = -gain*x[k] + xd[k] + gain*yd[k];
+    }
+
+    void mixMono(float* out, const float* early, const float* late,
+                 float dry, float wet, float gain, int numSamples)
+    {
+        for (int k = 0; k < numSamples; ++k)
+            out[k] = dry*out[k] + wet*(gain*(early[k] + late[k]));
+    }
+
+    void mixStereo(float* left, float* right, const float* early, const float* late,
+                   float dry, float wet, float gain, int numSamples)
+    {
+        for (int k = 0; k < numSamples; ++k)
+            left[k] = dry*left[k] + wet*(gain*(early[2*k] + late[2*k]));
+        for (int k = 0; k < numSamples; ++k)
+            right[k] = dry*right[k] + wet*(gain*(early[2*k + 1] + late[2*k + 1]));
+    }
+
+    /* y = rt*(x[n-d] + (1-g)*(y[n-d] + g*y[n-d-1])) for every lane of a frame */
+    template <int width>
+    void combFrame(float* y, const float* xd, const float* fb, const float* fbPrev,
+                   const float* coefficient, float rt, float d)
+    {
+       #if MOORER_KERNEL_AVX512
+        if constexpr (width % 16 == 0) {
+            const __m512 one = _mm512_set1_ps(1.0f), dampingVec = _mm512_set1_ps(d), rtVec = _mm512_set1_ps(rt);
+            for (int v = 0; v < width; v += 16) {
+                const __m512 g = _mm512_mul_ps(dampingVec, _mm512_loadu_ps(coefficient + v));
+                const __m512 lowpass = _mm512_add_ps(_mm512_loadu_ps(fb + v), _mm512_mul_ps(g, _mm512_loadu_ps(fbPrev + v)));
+                const __m512 sum = _mm512_add_ps(_mm512_loadu_ps(xd + v), _mm512_mul_ps(_mm512_sub_ps(one, g), lowpass));
+                _mm512_storeu_ps(y + v, _mm512_mul_ps(rtVec, sum));
+            }
+            return;
+        }
+       #endif
+
+       #if MOORER_KERNEL_AVX2 || MOORER_KERNEL_AVX512 || defined(__AVX__)
+        const __m256 one = _mm256_set1_ps(1.0f), dampingVec = _mm256_set1_ps(d), rtVec = _mm256_set1_ps(rt);
+        for (int v = 0; v < width; v += 8) {
+            const __m256 g = _mm256_mul_ps(dampingVec, _mm256_loadu_ps(coefficient + v));
+            const __m256 lowpass = _mm256_add_ps(_mm256_loadu_ps(fb + v), _mm256_mul_ps(g, _mm256_loadu_ps(fbPrev + v)));
+            const __m256 sum = _mm256_add_ps(_mm256_loadu_ps(xd + v), _mm256_mul_ps(_mm256_sub_ps(one, g), lowpass));
+            _mm256_storeu_ps(y + v, _mm256_mul_ps(rtVec, sum));
+        }
+       #elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        const __m128 one = _mm_set1_ps(1.0f), dampingVec = _mm_set1_ps(d), rtVec = _mm_set1_ps(rt);
+        for (int v = 0; v < width; v += 4) {
+            const __m128 g = _mm_mul_ps(dampingVec, _mm_loadu_ps(coefficient + v));
+            const __m128 lowpass = _mm_add_ps(_mm_loadu_ps(fb + v), _mm_mul_ps(g, _mm_loadu_ps(fbPrev + v)));
+            const __m128 sum = _mm_add_ps(_mm_loadu_ps(xd + v), _mm_mul_ps(_mm_sub_ps(one, g), lowpass));
+            _mm_storeu_ps(y + v, _mm_mul_ps(rtVec, sum));
+        }
+       #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+        const float32x4_t one = vdupq_n_f32(1.0f), dampingVec = vdupq_n_f32(d), rtVec = vdupq_n_f32(rt);
+        for (int v = 0; v < width; v += 4) {
+            const float32x4_t g = vmulq_f32(dampingVec, vld1q_f32(coefficient + v));
+            const float32x4_t lowpass = vaddq_f32(vld1q_f32(fb + v), vmulq_f32(g, vld1q_f32(fbPrev + v)));
+            const float32x4_t sum = vaddq_f32(vld1q_f32(xd + v), vmulq_f32(vsubq_f32(one, g), lowpass));
+            vst1q_f32(y + v, vmulq_f32(rtVec, sum));
+        }
+       #else
+        for (int v = 0; v < width; ++v) {
+            const float g = d*coefficient[v];
+            y[v] = rt*(xd[v] + (1 - g)*(fb[v] + g*fbPrev[v]));
+        }
+       #endif
+    }
+
+    template <int channels>
+    void combFramesFor(const DspKernels::CombFrames& run)
+    {
+        constexpr int width = CombBank::maxCombs*channels;
+        alignas(64) float y[width];
+        float* destinations[width];
+        const int numLanes = run.numCombs*channels;
+
+        for (int k = 0; k < run.numSamples;) {
+            // each lane's output goes its delay ahead; within a stretch where
+            // none of those writes wraps, every lane's destination moves on by
+            // one frame per sample
+            int stretch = run.numSamples - k;
+            for (int lane = 0; lane < numLanes; ++lane) {
+                const uint32_t target = run.position + (uint32_t)k + (uint32_t)run.delays[lane];
+                const int contiguous = run.frames->contiguous(target);
+                stretch = contiguous < stretch ? contiguous : stretch;
+                destinations[lane] = run.frames->at(target) + lane;
+            }
+
+            for (int j = 0; j < stretch; ++j, ++k) {
+                const uint32_t dpw = run.position + (uint32_t)k;
+                const float rt = run.reverbTimes != nullptr ? run.reverbTimes[k] : run.reverbTime;
+                const float d = run.dampings != nullptr ? run.dampings[k] : run.damping;
+                combFrame<width>(y, run.input + (size_t)k*width, run.frames->at(dpw), run.frames->at(dpw - 1),
+                                 run.coefficients, rt, d);
+
+                for (int lane = 0; lane < numLanes; ++lane)
+                    destinations[lane][j*width] = y[lane];
+
+                // the sum runs in comb order so it matches the scalar combs bit for bit
+                float combSum[channels] {};
+                for (int i = 0; i < run.numCombs; i++)
+                    for (int c = 0; c < channels; ++c)
+                        combSum[c] += y[i*channels + c];
+
+                float* out = run.output->at(dpw);
+                for (int c = 0; c < channels; ++c)
+                    out[c] = combSum[c];
+            }
+        }
+    }
+
+    void combFrames(const DspKernels::CombFrames& run)
+    {
+        switch (run.channels) {
+            case 8:  combFramesFor<8>(run); break;
+            case 4:  combFramesFor<4>(run); break;
+            case 2:  combFramesFor<2>(run); break;
+            default: combFramesFor<1>(run); break;
+        }
+    }
+
+    const DspKernels kernelTable { MOORER_KERNEL_ISA, multiplyAdd, add, comb, combRamped, allpass, mixMono, mixStereo, combFrames };
+}
@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    Halfband.h
+
+    2x decimation and interpolation with a 15-tap halfband lowpass (Kaiser
+    window, beta 4): flat to 0.15 fs within 0.03 dB and at least 50 dB down
+    from 0.35 fs. Only the centre tap and every other tap are non-zero, so a
+    decimated sample costs nine multiplies, and of each interpolated pair one
+    is just a copy of the input.
+
+    Both kernels work on plain unwrapped arrays of interleaved frames, one
+    polyphase branch at a time, so their loops run with unit stride; the
+    caller copies the window it needs out of its delay line first.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+struct Halfband
+{
+    static constexpr int numSideTaps = 4;
+
+    /* delay of one decimate or interpolate pass, in samples at the higher rate */
+    static constexpr int latency = 2*numSideTaps - 1;
+
+    static constexpr float centreTap = 0.5f;
+
+    // outermost first, normalised for unity gain at DC
+    static constexpr float sideTaps[numSideTaps] = { -4.017699466e-03f, 2.337305694e-02f,
+                                                     -7.615580241e-02f, 3.068004449e-01f };
+
+    /* even and odd hold the even and odd frames of the input; output j is
+       the filtered input centred on odd frame j + numSideTaps - 1 */
+    template <int lanes, typename SampleType>
+    static void decimate(const SampleType* even, const SampleType* odd, SampleType* y, int numOutputs)
+    {
+        for (int t = 0; t < numOutputs*lanes; ++t) {
+            SampleType sum = centreTap*odd[t + (numSideTaps - 1)*lanes];
+            for (int i = 0; i < numSideTaps; ++i)
+                sum += sideTaps[i]*(even[t + i*lanes] + even[t + (latency - i)*lanes]);
+            y[t] = sum;
+        }
+    }
+
+    /* the even outputs of a 2x upsampling, output q centred on frame
+       q + latency of x; the odd ones fall on the centre tap and are just
+       frame q + numSideTaps of x */
+    template <int lanes, typename SampleType>
+    static void interpolate(const SampleType* x, SampleType* y, int numOutputs)
+    {
+        for (int t = 0; t < numOutputs*lanes; ++t) {
+            SampleType sum = 0;
+            for (int i = 0; i < numSideTaps; ++i)
+                sum += sideTaps[i]*(x[t + i*lanes] + x[t + (latency - i)*lanes]);
+            y[t] = 2*sum;
+        }
+    }
+};
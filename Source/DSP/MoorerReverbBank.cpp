@@ -0,0 +1,366 @@
+/*
+  ==============================================================================
+
+    MoorerReverbBank.cpp
+
+  ==============================================================================
+*/
+
+#include "MoorerReverbBank.h"
+
+#include <algorithm>
+#include <cmath>
+
+using Topology = MoorerTopology;
+
+namespace
+{
+    constexpr int lanes = MoorerReverbBank::groupLanes;
+
+    uint32_t nextPowerOfTwo(int length)
+    {
+        uint32_t size = 1;
+        while (size < (uint32_t)length)
+            size <<= 1;
+        return size;
+    }
+}
+
+//==============================================================================
+void MoorerReverbBank::prepare(double newSampleRate, int newNumInstances)
+{
+    sampleRate = newSampleRate;
+    numInstances = std::max(0, newNumInstances);
+    numGroups = (numInstances + lanes - 1)/lanes;
+
+    for (int i = 0; i < numCombs; i++)
+        combOffsets[i] = MoorerReverbEngine::combOffset(i, sampleRate);
+    allpassOffset = MoorerReverbEngine::allpassOffsetFor(0, sampleRate);
+
+    /* each line only holds its own longest read plus one chunk, which keeps
+       a group's part of the block as small as possible */
+    int longestComb = 0;
+    for (int i = 0; i < numCombs; i++)
+        longestComb = std::max(longestComb, combOffsets[i]);
+    const int longestTap = MoorerReverbEngine::firOffset(numTaps - 1, Topology::maxPredelay, sampleRate);
+    const int longestAlignment = MoorerReverbEngine::alignmentOffsetFor(Topology::maxPredelay, sampleRate);
+
+    groupSize = 0;
+    auto layout = [this](Line& line, int longestRead) {
+        const uint32_t frames = nextPowerOfTwo(longestRead + 1 + maxChunkSize);
+        line.offset = groupSize;
+        line.mask = frames - 1;
+        groupSize += (size_t)frames*lanes;
+    };
+
+    layout(inputDelay, longestTap);
+    layout(firDelay, longestComb);
+    for (int i = 0; i < numCombs; i++)
+        layout(combDelays[i], combOffsets[i] + 1);
+    layout(combDelay, allpassOffset);
+    layout(allpassDelay, std::max(allpassOffset, longestAlignment));
+
+    memory.assign(groupSize*(size_t)numGroups, 0.0f);
+
+    // instances keep the parameters last set for them, even before this; the rest get the defaults
+    const size_t numLanes = (size_t)(numGroups*lanes);
+    reserveParameters(std::max(numLanes, reverbTimeTargets.size()));
+
+    reverbTimes = reverbTimeTargets;
+    dampings = dampingTargets;
+    wetMixes = wetMixTargets;
+
+    for (auto& offsets : firOffsets)
+        offsets.resize(numLanes);
+    alignmentOffsets.resize(numLanes);
+    for (int lane = 0; lane < (int)numLanes; ++lane)
+        updateOffsets(lane);
+
+    reset();
+}
+
+void MoorerReverbBank::reset()
+{
+    std::fill(memory.begin(), memory.end(), 0.0f);
+    writePosition = 0;
+}
+
+void MoorerReverbBank::reserveParameters(size_t numLanes)
+{
+    const MoorerReverbParameters defaults;
+    reverbTimeTargets.resize(numLanes, defaults.reverbTime);
+    dampingTargets.resize(numLanes, defaults.damping);
+    wetMixTargets.resize(numLanes, defaults.wetMix);
+    predelays.resize(numLanes, defaults.predelay);
+}
+
+void MoorerReverbBank::setParameters(int instance, const MoorerReverbParameters& newParameters)
+{
+    if (instance < 0)
+        return;
+
+    // an instance that isn't prepared yet holds on to them until it is
+    const size_t lane = (size_t)instance;
+    if (lane >= reverbTimeTargets.size())
+        reserveParameters(lane + 1);
+
+    reverbTimeTargets[lane] = newParameters.reverbTime;
+    dampingTargets[lane] = newParameters.damping;
+    wetMixTargets[lane] = newParameters.wetMix;
+
+    const float predelay = std::fmin(std::fmax(newParameters.predelay, 0.0f), Topology::maxPredelay);
+    if (predelay != predelays[lane]) {
+        predelays[lane] = predelay;
+        if (lane < alignmentOffsets.size())
+            updateOffsets(instance);
+    }
+}
+
+void MoorerReverbBank::updateOffsets(int lane)
+{
+    const size_t n = (size_t)lane;
+    for (int i = 0; i < numTaps; i++)
+        firOffsets[i][n] = MoorerReverbEngine::firOffset(i, predelays[n], sampleRate);
+    alignmentOffsets[n] = MoorerReverbEngine::alignmentOffsetFor(predelays[n], sampleRate);
+}
+
+//==============================================================================
+void MoorerReverbBank::process(const float* const* inputs, float* const* outputs, int numSamples)
+{
+    for (int offset = 0; offset < numSamples; offset += maxChunkSize) {
+        const int chunk = std::min(maxChunkSize, numSamples - offset);
+        for (int group = 0; group < numGroups; ++group)
+            processGroup(group, inputs, outputs, offset, chunk);
+        writePosition += (uint32_t)chunk;
+    }
+}
+
+void MoorerReverbBank::processGroup(int group, const float* const* inputs, float* const* outputs, int offset, int numSamples)
+{
+    const bool ramping = renderGains(group, numSamples);
+
+    /* FIR DELAY TAPS */
+    firTaps(group, inputs, offset, numSamples);
+    /* ============== */
+
+
+    /* PARALLEL IIR COMB FILTERS */
+    clearCombSum(group, numSamples);
+    for (int i = 0; i < numCombs; i++)
+        combFilter(group, i, ramping, numSamples);
+    /* ========================= */
+
+
+    /* ALLPASS SECTION */
+    allpassFilter(group, numSamples);
+    /* =============== */
+
+
+    mix(group, outputs, offset, ramping, numSamples);
+}
+
+bool MoorerReverbBank::renderGains(int group, int numSamples)
+{
+    const size_t first = (size_t)(group*lanes);
+
+    bool changed = false;
+    for (size_t n = first; n < first + lanes; ++n)
+        changed = changed || reverbTimes[n] != reverbTimeTargets[n] || dampings[n] != dampingTargets[n]
+                          || wetMixes[n] != wetMixTargets[n];
+
+    if (! changed)
+        return false;
+
+    // every lane moves linearly across the chunk and lands on its target at the last frame
+    std::vector<float>* currents[3] = { &reverbTimes, &dampings, &wetMixes };
+    const std::vector<float>* targets[3] = { &reverbTimeTargets, &dampingTargets, &wetMixTargets };
+
+    for (int p = 0; p < 3; ++p) {
+        const float* current = currents[p]->data() + first;
+        const float* target = targets[p]->data() + first;
+        float* values = rampValues[p];
+
+        for (int k = 0; k < numSamples - 1; ++k) {
+            const float progress = (float)(k + 1)/(float)numSamples;
+            for (int n = 0; n < lanes; ++n)
+                values[k*lanes + n] = current[n] + (target[n] - current[n])*progress;
+        }
+        std::copy(target, target + lanes, values + (numSamples - 1)*lanes);
+        std::copy(target, target + lanes, currents[p]->data() + first);
+    }
+
+    return true;
+}
+
+void MoorerReverbBank::firTaps(int group, const float* const* inputs, int offset, int numSamples)
+{
+    /* each instance has its own predelay, so the input line keeps one plain
+       ring per lane and the taps run along time, lane by lane, into tapSums */
+    const int used = std::min(lanes, numInstances - group*lanes);
+
+    for (int n = 0; n < lanes; ++n) {
+        float* sum = tapSums[n];
+        if (n >= used) {
+            std::fill(sum, sum + numSamples, 0.0f);
+            continue;
+        }
+
+        const size_t lane = (size_t)(group*lanes + n);
+        const float* input = inputs[lane] + offset;
+        std::copy(input, input + numSamples, sum);
+
+        uint32_t dpw = writePosition;
+        for (int done = 0; done < numSamples;) {
+            const int run = std::min(numSamples - done, contiguous(inputDelay, dpw));
+            std::copy(input + done, input + done + run, laneRing(group, inputDelay, n, dpw));
+            dpw += (uint32_t)run;
+            done += run;
+        }
+
+        for (int i = 0; i < numTaps; i++) {
+            const float gain = Topology::firCoefficients[i];
+            uint32_t dpr = writePosition - (uint32_t)firOffsets[i][lane];
+
+            for (int done = 0; done < numSamples;) {
+                const int run = std::min(numSamples - done, contiguous(inputDelay, dpr));
+                const float* in = laneRing(group, inputDelay, n, dpr);
+
+                for (int k = 0; k < run; ++k)
+                    sum[done + k] += gain*in[k];
+
+                dpr += (uint32_t)run;
+                done += run;
+            }
+        }
+    }
+
+    // back into frames for the combs
+    uint32_t dpw = writePosition;
+    for (int done = 0; done < numSamples;) {
+        const int run = std::min(numSamples - done, contiguous(firDelay, dpw));
+        float* out = frame(group, firDelay, dpw);
+        for (int k = 0; k < run; ++k)
+            for (int n = 0; n < lanes; ++n)
+                out[k*lanes + n] = tapSums[n][done + k];
+        dpw += (uint32_t)run;
+        done += run;
+    }
+}
+
+void MoorerReverbBank::combFilter(int group, int comb, bool ramping, int numSamples)
+{
+    // y[n] = x[n-d] + g*y[n-d]
+    // lowpass feedback line: y[n] = (1-g)*(x[n] + g*x[n-1])
+    const Line& line = combDelays[comb];
+    const float coefficient = Topology::iirCoefficients[comb];
+
+    float rt[lanes], feedback[lanes], lowpass[lanes];
+    for (int n = 0; n < lanes; ++n) {
+        rt[n] = reverbTimes[(size_t)(group*lanes + n)];
+        feedback[n] = dampings[(size_t)(group*lanes + n)]*coefficient;
+        lowpass[n] = 1 - feedback[n];
+    }
+
+    uint32_t dpw = writePosition;
+    uint32_t dpr = writePosition - (uint32_t)combOffsets[comb];
+
+    for (int done = 0; done < numSamples;) {
+        const int run = std::min({ numSamples - done, contiguous(line, dpw), contiguous(combDelay, dpw),
+                                   contiguous(firDelay, dpr), contiguous(line, dpr), contiguous(line, dpr - 1) });
+        float* out = frame(group, line, dpw);
+        float* combSum = frame(group, combDelay, dpw);
+        const float* xd = frame(group, firDelay, dpr);
+        const float* fb = frame(group, line, dpr);
+        const float* fbPrev = frame(group, line, dpr - 1);
+
+        // the same delay for every lane, so each frame is one vector step; the
+        // sum is accumulated here, in comb order, rather than in another pass
+        if (! ramping) {
+            for (int k = 0; k < run; ++k)
+                for (int n = 0; n < lanes; ++n) {
+                    const int j = k*lanes + n;
+                    out[j] = rt[n]*(xd[j] + lowpass[n]*(fb[j] + feedback[n]*fbPrev[j]));
+                    combSum[j] += out[j];
+                }
+        } else {
+            const float* rts = rampValues[0] + done*lanes;
+            const float* dampingValues = rampValues[1] + done*lanes;
+            for (int j = 0; j < run*lanes; ++j) {
+                const float g = dampingValues[j]*coefficient;
+                out[j] = rts[j]*(xd[j] + (1 - g)*(fb[j] + g*fbPrev[j]));
+                combSum[j] += out[j];
+            }
+        }
+
+        dpw += (uint32_t)run;
+        dpr += (uint32_t)run;
+        done += run;
+    }
+}
+
+void MoorerReverbBank::clearCombSum(int group, int numSamples)
+{
+    uint32_t dpw = writePosition;
+    for (int done = 0; done < numSamples;) {
+        const int run = std::min(numSamples - done, contiguous(combDelay, dpw));
+        std::fill(frame(group, combDelay, dpw), frame(group, combDelay, dpw) + run*lanes, 0.0f);
+        dpw += (uint32_t)run;
+        done += run;
+    }
+}
+
+void MoorerReverbBank::allpassFilter(int group, int numSamples)
+{
+    // y[n] = -g*x[n] + x[n-d] + g*y[n-d]
+    uint32_t dpw = writePosition;
+    uint32_t dpr = writePosition - (uint32_t)allpassOffset;
+
+    for (int done = 0; done < numSamples;) {
+        const int run = std::min({ numSamples - done, contiguous(allpassDelay, dpw), contiguous(combDelay, dpw),
+                                   contiguous(combDelay, dpr), contiguous(allpassDelay, dpr) });
+        float* out = frame(group, allpassDelay, dpw);
+        const float* x = frame(group, combDelay, dpw);
+        const float* xd = frame(group, combDelay, dpr);
+        const float* yd = frame(group, allpassDelay, dpr);
+
+        for (int j = 0; j < run*lanes; ++j)
+            out[j] = -Topology::allpassGain*x[j] + xd[j] + Topology::allpassGain*yd[j];
+
+        dpw += (uint32_t)run;
+        dpr += (uint32_t)run;
+        done += run;
+    }
+}
+
+void MoorerReverbBank::mix(int group, float* const* outputs, int offset, bool ramping, int numSamples)
+{
+    const int used = std::min(lanes, numInstances - group*lanes);
+
+    for (int n = 0; n < used; ++n) {
+        const size_t lane = (size_t)(group*lanes + n);
+        const float wet = wetMixes[lane];
+        float* out = outputs[lane] + offset;
+
+        // the dry signal comes back out of the input ring, since outputs may overwrite inputs
+        uint32_t dpw = writePosition;
+        uint32_t dpr = writePosition - (uint32_t)alignmentOffsets[lane];
+
+        for (int done = 0; done < numSamples;) {
+            const int run = std::min({ numSamples - done, contiguous(inputDelay, dpw), contiguous(firDelay, dpw),
+                                       contiguous(allpassDelay, dpr) });
+            const float* in = laneRing(group, inputDelay, n, dpw);
+            const float* early = frame(group, firDelay, dpw) + n;
+            const float* late = frame(group, allpassDelay, dpr) + n;
+            const float* wets = rampValues[2] + done*lanes + n;
+
+            for (int k = 0; k < run; ++k) {
+                const float w = ramping ? wets[k*lanes] : wet;
+                out[done + k] = (1.0f - w)*in[k] + w*(Topology::outputGain*(early[k*lanes] + late[k*lanes]));
+            }
+
+            dpw += (uint32_t)run;
+            dpr += (uint32_t)run;
+            done += run;
+        }
+    }
+}
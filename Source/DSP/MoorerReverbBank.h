@@ -0,0 +1,106 @@
+/*
+  ==============================================================================
+
+    MoorerReverbBank.h
+
+    Headless renderer for many independent mono reverbs at once. Instances
+    are packed eight to a group, one per lane: every delay line of a group is
+    a ring of 8-wide frames, and the groups sit back to back in one memory
+    block. The combs, comb sum and allpass use the same delays for every
+    instance, so within a group they run as plain vector loops across the
+    lanes; only the predelayed taps (whose offsets depend on each instance's
+    predelay) are read lane by lane. Groups are rendered one after the other,
+    so only one group's lines need to stay in cache at a time.
+
+    Parameters are per instance. Gain changes are interpolated across one
+    chunk; predelay changes move the taps straight to their new offsets.
+    With constant parameters every instance's output is bit-identical to a
+    mono MoorerReverbEngine's with the same ones.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "MoorerReverbEngine.h"
+
+class MoorerReverbBank
+{
+public:
+    static constexpr int numTaps = MoorerTopology::numTaps;
+    static constexpr int numCombs = MoorerTopology::numCombs;
+    static_assert(MoorerTopology::numAllpasses == 1, "the bank runs a single allpass");
+    static constexpr int maxChunkSize = 512;
+
+    /* instances per group, i.e. lanes per frame */
+    static constexpr int groupLanes = 8;
+
+    /* clears all state; every instance starts straight at the parameters
+       last set for it, before this or since an earlier prepare(), or at the
+       defaults if it has none */
+    void prepare(double sampleRate, int numInstances);
+    void reset();
+
+    int getNumInstances() const { return numInstances; }
+    size_t getMemoryBytes() const { return memory.size()*sizeof(float); }
+
+    /* any instance, prepared or not; one beyond every instance prepared so
+       far allocates room for its parameters, so set those before prepare()
+       rather than while processing */
+    void setParameters(int instance, const MoorerReverbParameters& newParameters);
+
+    /* renders one mono stream per instance; inputs and outputs may be the same buffers */
+    void process(const float* const* inputs, float* const* outputs, int numSamples);
+
+private:
+    /* a ring inside a group's part of the block: frames of groupLanes samples,
+       or (for the input line) one plain ring per lane */
+    struct Line
+    {
+        size_t offset {0};
+        uint32_t mask {0};
+    };
+
+    int numInstances {0}, numGroups {0};
+    size_t groupSize {0};
+    double sampleRate {44100.0};
+    uint32_t writePosition {0};
+
+    std::vector<float> memory;
+    Line inputDelay, firDelay, combDelays[numCombs], combDelay, allpassDelay;
+
+    /* per-lane values (numGroups*groupLanes of each): the gains in effect at
+       the start of the next chunk and the ones to reach by its end */
+    std::vector<float> reverbTimes, dampings, wetMixes;
+    std::vector<float> reverbTimeTargets, dampingTargets, wetMixTargets;
+    std::vector<float> predelays;
+    std::vector<int> firOffsets[numTaps];
+    std::vector<int> alignmentOffsets;
+    int combOffsets[numCombs] {};
+    int allpassOffset {0};
+
+    /* scratch for one group and chunk */
+    float tapSums[groupLanes][maxChunkSize];
+    float rampValues[3][maxChunkSize*groupLanes];
+
+    float* frame(int group, const Line& line, uint32_t position)
+    {
+        return memory.data() + (size_t)group*groupSize + line.offset + (size_t)(position & line.mask)*groupLanes;
+    }
+    float* laneRing(int group, const Line& line, int lane, uint32_t position)
+    {
+        return memory.data() + (size_t)group*groupSize + line.offset + (size_t)lane*(line.mask + 1) + (position & line.mask);
+    }
+    static int contiguous(const Line& line, uint32_t position) { return (int)(line.mask - (position & line.mask)) + 1; }
+
+    void reserveParameters(size_t numLanes);
+    void updateOffsets(int lane);
+
+    void processGroup(int group, const float* const* inputs, float* const* outputs, int offset, int numSamples);
+    bool renderGains(int group, int numSamples);
+    void firTaps(int group, const float* const* inputs, int offset, int numSamples);
+    void clearCombSum(int group, int numSamples);
+    void combFilter(int group, int comb, bool ramping, int numSamples);
+    void allpassFilter(int group, int numSamples);
+    void mix(int group, float* const* outputs, int offset, bool ramping, int numSamples);
+};
@@ -0,0 +1,1220 @@
+/*
+  ==============================================================================
+
+    MoorerReverbEngine.cpp
+
+  ==============================================================================
+*/
+
+#include "MoorerReverbEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if MOORER_STAGE_PROFILER
+ #define MOORER_PROFILE_STAGE_ON(stageProfiler, stage) \
+    const StageProfiler::Scope stageScope(stageProfiler, StageProfiler::Stage::stage, track)
+#else
+ #define MOORER_PROFILE_STAGE_ON(stageProfiler, stage)
+#endif
+#define MOORER_PROFILE_STAGE(stage) MOORER_PROFILE_STAGE_ON(profiler, stage)
+
+namespace
+{
+    /* the float engine runs its inner loops through the dispatched kernels;
+       there are no double kernels, so the double engine runs the same
+       arithmetic here and leaves vectorising it to the compiler */
+    void multiplyAdd(const DspKernels& kernels, float* out, const float* in, float gain, int numSamples)
+    {
+        kernels.multiplyAdd(out, in, gain, numSamples);
+    }
+
+    void multiplyAdd(const DspKernels&, double* out, const double* in, double gain, int numSamples)
+    {
+        for (int k = 0; k < numSamples; ++k)
+            out[k] += gain*in[k];
+    }
+
+    void add(const DspKernels& kernels, float* out, const float* in, int numSamples)
+    {
+        kernels.add(out, in, numSamples);
+    }
+
+    void add(const DspKernels&, double* out, const double* in, int numSamples)
+    {
+        for (int k = 0; k < numSamples; ++k)
+            out[k] += in[k];
+    }
+
+    void comb(const DspKernels& kernels, float* out, const float* xd, const float* fb, const float* fbPrev,
+              float rt, float lowpass, float feedback, int numSamples)
+    {
+        kernels.comb(out, xd, fb, fbPrev, rt, lowpass, feedback, numSamples);
+    }
+
+    void comb(const DspKernels&, double* out, const double* xd, const double* fb, const double* fbPrev,
+              double rt, double lowpass, double feedback, int numSamples)
+    {
+        for (int k = 0; k < numSamples; ++k)
+            out[k] = rt*(xd[k] + lowpass*(fb[k] + feedback*fbPrev[k]));
+    }
+
+    void combRamped(const DspKernels& kernels, float* out, const float* xd, const float* fb, const float* fbPrev,
+                    const float* rts, const float* dampings, float coefficient, int lanes, int numFrames)
+    {
+        kernels.combRamped(out, xd, fb, fbPrev, rts, dampings, coefficient, lanes, numFrames);
+    }
+
+    void combRamped(const DspKernels&, double* out, const double* xd, const double* fb, const double* fbPrev,
+                    const float* rts, const float* dampings, float coefficient, int lanes, int numFrames)
+    {
+        for (int k = 0; k < numFrames; ++k) {
+            const double rt = rts[k];
+            const double g = (double)dampings[k]*coefficient;
+            for (int c = 0; c < lanes; ++c) {
+                const int j = k*lanes + c;
+                out[j] = rt*(xd[j] + (1 - g)*(fb[j] + g*fbPrev[j]));
+            }
+        }
+    }
+
+    void allpass(const DspKernels& kernels, float* out, const float* x, const float* xd, const float* yd,
+                 float gain, int numSamples)
+    {
+        kernels.allpass(out, x, xd, yd, gain, numSamples);
+    }
+
+    void allpass(const DspKernels&, double* out, const double* x, const double* xd, const double* yd,
+                 double gain, int numSamples)
+    {
+        for (int k = 0; k < numSamples; ++k)
+            out[k] = -gain*x[k] + xd[k] + gain*yd[k];
+    }
+
+    void mixMono(const DspKernels& kernels, float* out, const float* early, const float* late,
+                 float dry, float wet, float gain, int numSamples)
+    {
+        kernels.mixMono(out, early, late, dry, wet, gain, numSamples);
+    }
+
+    void mixMono(const DspKernels&, double* out, const double* early, const double* late,
+                 double dry, double wet, double gain, int numSamples)
+    {
+        for (int k = 0; k < numSamples; ++k)
+            out[k] = dry*out[k] + wet*(gain*(early[k] + late[k]));
+    }
+
+    void mixStereo(const DspKernels& kernels, float* left, float* right, const float* early, const float* late,
+                   float dry, float wet, float gain, int numSamples)
+    {
+        kernels.mixStereo(left, right, early, late, dry, wet, gain, numSamples);
+    }
+
+    void mixStereo(const DspKernels&, double* left, double* right, const double* early, const double* late,
+                   double dry, double wet, double gain, int numSamples)
+    {
+        for (int k = 0; k < numSamples; ++k)
+            left[k] = dry*left[k] + wet*(gain*(early[2*k] + late[2*k]));
+        for (int k = 0; k < numSamples; ++k)
+            right[k] = dry*right[k] + wet*(gain*(early[2*k + 1] + late[2*k + 1]));
+    }
+
+    /* wider sets, a channel at a time, with the same arithmetic as the kernels */
+    template <int lanes, typename SampleType>
+    void mixLanes(SampleType* const* out, int offset, const SampleType* early, const SampleType* late,
+                  SampleType dry, SampleType wet, SampleType gain, int numSamples)
+    {
+        for (int c = 0; c < lanes; ++c) {
+            SampleType* channel = out[c] + offset;
+            for (int k = 0; k < numSamples; ++k)
+                channel[k] = dry*channel[k] + wet*(gain*(early[k*lanes + c] + late[k*lanes + c]));
+        }
+    }
+
+    /* adds every lane's early and late sum, times gain, into tap */
+    template <int lanes, typename SampleType>
+    void addWet(SampleType* tap, const SampleType* early, const SampleType* late, SampleType gain, int numSamples)
+    {
+        for (int k = 0; k < numSamples; ++k)
+            for (int c = 0; c < lanes; ++c)
+                tap[k] += gain*(early[k*lanes + c] + late[k*lanes + c]);
+    }
+
+    // the first two are 1 so mono and stereo keep the topology's delays
+    const float channelSpreads[] = { 1.0f,   1.0f,   0.953f, 1.047f, 0.971f, 1.029f, 0.937f, 1.063f,
+                                     0.983f, 1.017f, 0.929f, 1.071f, 0.961f, 1.039f, 0.947f, 1.053f };
+}
+
+float MoorerReverbEngineBase::channelSpread(int channel)
+{
+    constexpr int numSpreads = (int)(sizeof(channelSpreads)/sizeof(channelSpreads[0]));
+    return channelSpreads[channel % numSpreads];
+}
+
+//==============================================================================
+template <typename SampleType, typename Topology>
+void BasicMoorerReverbEngine<SampleType, Topology>::reserve(double maxSampleRate, int maxChannels)
+{
+    if (worker != nullptr)
+        worker->collect();
+    if (pipelined && worker == nullptr)
+        worker = std::make_unique<PipelineWorker>();
+
+    const auto requestedEngine = combEngine;
+    const int requestedDecimation = decimation;
+
+    // every layout prepare() could pick at this rate; the arena keeps the largest
+    size_t largest = 0;
+    for (auto engine : { CombEngine::scalar, CombEngine::simd }) {
+        for (int factor = 1; factor <= maxDecimation; factor *= 2) {
+            for (bool interleave : { false, true }) {
+                combEngine = engine;
+                decimation = factor;
+                configure(maxSampleRate, maxChannels, interleave);
+                layOut();
+                largest = std::max(largest, arena.getLayoutSize());
+            }
+        }
+    }
+    arena.reserve(largest);
+
+    combEngine = requestedEngine;
+    decimation = requestedDecimation;
+}
+
+template <typename SampleType, typename Topology>
+bool BasicMoorerReverbEngine<SampleType, Topology>::setIsa(DspKernels::Isa isa)
+{
+    if (worker != nullptr)
+        worker->collect();
+
+    const DspKernels* forced = DspKernels::forIsa(isa);
+    if (forced == nullptr)
+        return false;
+
+    kernels = forced;
+    for (auto& channel : channels)
+        channel.combBank.setKernels(*kernels);
+    return true;
+}
+
+template <typename SampleType, typename Topology>
+void BasicMoorerReverbEngine<SampleType, Topology>::prepare(double newSampleRate, int numChannels)
+{
+    if (worker != nullptr)
+        worker->collect();
+    if (pipelined && worker == nullptr)
+        worker = std::make_unique<PipelineWorker>();
+    else if (! pipelined)
+        worker.reset();
+
+    configure(newSampleRate, numChannels, interleaveChannels);
+    layOut();
+    arena.allocate();
+
+    /* feedback gains glide exponentially, the mix and the predelay glide linearly
+       (the predelay ramp is the 0-1 progress of the taps towards their new offsets) */
+    reverbTimeRamp.reset(sampleRate, 0.05, ParameterRamp::Shape::exponential);
+    dampingRamp.reset(sampleRate, 0.05, ParameterRamp::Shape::exponential);
+    wetMixRamp.reset(sampleRate, 0.02, ParameterRamp::Shape::linear);
+    predelayRamp.reset(sampleRate, 0.1, ParameterRamp::Shape::linear);
+
+    reverbTimeRamp.snap(parameters.reverbTime);
+    dampingRamp.snap(parameters.damping);
+    wetMixRamp.snap(parameters.wetMix);
+    predelayRamp.snap(1.0f);
+
+    predelay = std::fmin(std::fmax(parameters.predelay, 0.0f), Topology::maxPredelay);
+    updatePredelayOffsets();
+    reset();
+}
+
+template <typename SampleType, typename Topology>
+void BasicMoorerReverbEngine<SampleType, Topology>::configure(double newSampleRate, int numChannels, bool interleave)
+{
+    sampleRate = newSampleRate;
+    stages = decimation == 4 ? 2 : decimation == 2 ? 1 : 0;
+    const double lateRate = sampleRate/(double)(1 << stages);
+
+    // allpass lengths are fixed, so they only change with the sample rate
+    for (int i = 0; i < numAllpasses; i++)
+        allpassOffsets[i] = allpassOffsetFor(i, lateRate);
+
+    // each halfband stage delays the late path by 2*latency samples at its higher rate
+    resamplingLatency = 2*Halfband::latency*((1 << stages) - 1);
+
+    /* a stereo pair shares one set of two-lane lines; more channels are packed
+       into sets of maxLanes, then of whatever power of two is left, but only
+       when the bank can give each lane its own comb delays. Anything else
+       gets a set per channel */
+    const bool packPair = interleave && numChannels == 2;
+    const bool packWide = interleave && numChannels > 2 && usesCombBank();
+    auto lanesFrom = [&](int first) {
+        int lanes = packPair ? 2 : packWide ? maxLanes : 1;
+        while (lanes > numChannels - first)
+            lanes >>= 1;
+        return lanes;
+    };
+    numLineSets = 0;
+    for (int first = 0; first < numChannels; first += lanesFrom(first))
+        ++numLineSets;
+    interleaved = packPair || packWide;
+    numChannelsPrepared = numChannels;
+
+    // these only ever grow, so a channel's comb bank keeps its buffers between prepares
+    if ((int)channels.size() < numLineSets)
+        channels.resize((size_t)numLineSets);
+    if ((int)chunkPointers.size() < std::max(2, numChannels))
+        chunkPointers.resize((size_t)std::max(2, numChannels));
+
+    // comb lengths also depend on the channel, to decorrelate them
+    longestComb = 0;
+    int widest = 1;
+    for (int set = 0, first = 0; set < numLineSets; ++set) {
+        auto& channel = channels[(size_t)set];
+        channel.firstChannel = first;
+        channel.lanes = lanesFrom(first);
+        channel.longestComb = 0;
+        for (int i = 0; i < numCombs; i++) {
+            for (int c = 0; c < channel.lanes; ++c) {
+                const int offset = combOffsetFor(i, first + c, lateRate);
+                channel.combOffsets[i*channel.lanes + c] = offset;
+                channel.longestComb = std::max(channel.longestComb, offset);
+            }
+        }
+        longestComb = std::max(longestComb, channel.longestComb);
+        widest = std::max(widest, channel.lanes);
+        first += channel.lanes;
+    }
+
+    // a halfband pass copies out and splits at most half a chunk plus the filter, twice over
+    resampleWindow.resize((size_t)(4*(maxChunkSize/2 + Halfband::latency + 1))*(size_t)std::max(2, widest));
+}
+
+template <typename SampleType, typename Topology>
+void BasicMoorerReverbEngine<SampleType, Topology>::layOut()
+{
+    /* a line holds the furthest back it's read (and the frame behind that, for
+       the gliding and feedback reads) plus one chunk, since a stage writes a
+       whole chunk before the next stage reads it */
+    auto reach = [](int delay) { return delay + 1 + maxChunkSize; };
+    const int longestTap = firOffset(numTaps - 1, Topology::maxPredelay, sampleRate);
+    const int longestAlignment = alignmentOffsetFor(Topology::maxPredelay, sampleRate);
+
+    // one block for everything, laid out in the order each chunk runs through it
+    arena.beginLayout();
+    for (int set = 0; set < numLineSets; ++set) {
+        auto& channel = channels[(size_t)set];
+        const int lanes = channel.lanes;
+        arena.add(channel.inputDelay, reach(longestTap), lanes);
+        arena.add(channel.firDelay, reach(stages > 0 ? 2*Halfband::latency : channel.longestComb), lanes);
+        for (int s = 0; s < stages; ++s)
+            arena.add(channel.decimated[s], reach(s < stages - 1 ? 2*Halfband::latency : channel.longestComb), lanes);
+
+        // the combs live either in their own lines or in the bank, never both
+        if (usesCombBank()) {
+            channel.combBank.setKernels(*kernels);
+            channel.combBank.prepare(channel.combOffsets, Topology::iirCoefficients, numCombs, lanes, maxChunkSize, arena);
+        } else {
+            for (int i = 0; i < numCombs; i++)
+                arena.add(channel.combDelays[i], reach(channel.combOffsets[i*lanes]), lanes);
+        }
+
+        // each allpass is read back by itself and by the next one in line, the last by the output
+        arena.add(channel.combDelay, reach(allpassOffsets[0]), lanes);
+        for (int i = 0; i < numAllpasses; i++) {
+            const int next = i < numAllpasses - 1 ? allpassOffsets[i + 1] : stages > 0 ? Halfband::latency : longestAlignment;
+            arena.add(channel.allpassDelays[i], reach(std::max(allpassOffsets[i], next)), lanes);
+        }
+        for (int s = stages - 1; s >= 0; --s)
+            arena.add(channel.interpolated[s], reach(s > 0 ? Halfband::latency : longestAlignment - resamplingLatency), lanes);
+    }
+}
+
+template <typename SampleType, typename Topology>
+void BasicMoorerReverbEngine<SampleType, Topology>::reset()
+{
+    if (worker != nullptr)
+        worker->collect();
+
+    // the comb bank's frames are in the arena too
+    arena.clear();
+
+    writePosition = 0;
+    latePending = false;
+    silentInput = quietOutput = 0;
+    sleeping = false;
+}
+
+template <typename SampleType, typename Topology>
+void BasicMoorerReverbEngine<SampleType, Topology>::setDecimation(int factor)
+{
+    decimation = factor >= maxDecimation ? maxDecimation : factor >= 2 ? 2 : 1;
+}
+
+template <typename SampleType, typename Topology>
+void BasicMoorerReverbEngine<SampleType, Topology>::setParameters(const MoorerReverbParameters& newParameters)
+{
+    parameters = newParameters;
+
+    reverbTimeRamp.setTarget(parameters.reverbTime);
+    dampingRamp.setTarget(parameters.damping);
+    wetMixRamp.setTarget(parameters.wetMix);
+    setPredelay(parameters.predelay);
+}
+
+template <typename SampleType, typename Topology>
+void BasicMoorerReverbEngine<SampleType, Topology>::setPredelay(float seconds)
+{
+    seconds = std::fmin(std::fmax(seconds, 0.0f), Topology::maxPredelay);
+
+    if (seconds == predelay)
+        return;
+
+    // a change mid-glide carries on from wherever the taps are now
+    for (int i = 0; i < numTaps; i++)
+        firStart[i] = currentDelay(firStart[i], firOffsets[i]);
+    alignmentStart = currentDelay(alignmentStart, alignmentOffset);
+
+    predelay = seconds;
+    updatePredelayOffsets();
+
+    predelayRamp.snap(0.0f);
+    predelayRamp.setTarget(1.0f);
+}
+
+template <typename SampleType, typename Topology>
+float BasicMoorerReverbEngine<SampleType, Topology>::currentDelay(float start, int target) const
+{
+    if (! predelayRamp.isRamping())
+        return (float)target;
+
+    return start + ((float)target - start)*predelayRamp.getCurrent();
+}
+
+template <typename SampleType, typename Topology>
+void BasicMoorerReverbEngine<SampleType, Topology>::updatePredelayOffsets()
+{
+    for (int i = 0; i < numTaps; i++)
+        firOffsets[i] = firOffset(i, predelay, sampleRate);
+    alignmentOffset = alignmentOffsetFor(predelay, sampleRate);
+}
+
+//==============================================================================
+template <typename SampleType, typename Topology>
+int BasicMoorerReverbEngine<SampleType, Topology>::firOffset(int tap, float predelay, double sampleRate)
+{
+    // the per-sample code computed these in single precision from the integer rate
+    return toSamples((predelay + Topology::firDelayLengths[tap])*(float)(int)sampleRate);
+}
+
+template <typename SampleType, typename Topology>
+int BasicMoorerReverbEngine<SampleType, Topology>::alignmentOffsetFor(float predelay, double sampleRate)
+{
+    return toSamples((Topology::alignmentDelay + predelay)*(float)(int)sampleRate);
+}
+
+template <typename SampleType, typename Topology>
+int BasicMoorerReverbEngine<SampleType, Topology>::combOffset(int comb, double sampleRate)
+{
+    return (int)std::ceil(Topology::iirDelayLengths[comb]*sampleRate);
+}
+
+template <typename SampleType, typename Topology>
+int BasicMoorerReverbEngine<SampleType, Topology>::combOffsetFor(int comb, int channel, double sampleRate)
+{
+    return (int)std::ceil(Topology::iirDelayLengths[comb]*channelSpread(channel)*sampleRate);
+}
+
+template <typename SampleType, typename Topology>
+int BasicMoorerReverbEngine<SampleType, Topology>::allpassOffsetFor(int allpass, double sampleRate)
+{
+    return (int)std::ceil(Topology::allpassDelays[allpass]*sampleRate);
+}
+
+int MoorerReverbEngineBase::toSamples(float delay)
+{
+    /* read positions used to be (int)(write - delay + length), i.e. the delay
+       rounded up; a delay that lands within float rounding of a whole sample
+       (0.0415 s at 48k is 1992.0001) rounded down there, so do the same here */
+    return (int)std::ceil(delay - 0.001f);
+}
+
+//==============================================================================
+template <typename SampleType, typename Topology>
+void BasicMoorerReverbEngine<SampleType, Topology>::process(SampleType* const* channelData, int numChannels, int numSamples)
+{
+    // an interleaved set can't be run with some of its channels missing
+    if (interleaved && numChannels < numChannelsPrepared)
+        return;
+
+    numChannels = std::min(numChannels, numChannelsPrepared);
+    const int inFlight = getInFlight();
+    const int quietSpan = getQuietSpan();
+    wetTapGain = (SampleType)Topology::outputGain/(SampleType)std::max(1, numChannels);
+
+    for (int offset = 0; offset < numSamples; offset += maxChunkSize) {
+        const int chunk = std::min(maxChunkSize, numSamples - offset);
+        SampleType** chunkData = chunkPointers.data();
+        for (int channel = 0; channel < numChannels; ++channel)
+            chunkData[channel] = channelData[channel] + offset;
+
+        // every set adds its channels into it as it mixes
+        wetTapChunk = wetTap != nullptr ? wetTap + offset : nullptr;
+        if (wetTapChunk != nullptr)
+            std::fill(wetTapChunk, wetTapChunk + chunk, (SampleType)0);
+
+        // the last chunk's late stage has to be in the lines before anything else reads or moves them
+        if (latePending)
+            finishLate(quietSpan);
+
+        const bool silent = isSilent(chunkData, numChannels, chunk);
+        silentInput = silent ? std::min(silentInput + chunk, inFlight) : 0;
+
+        if (sleeping) {
+            if (silent) {
+                processAsleep(chunkData, numChannels, chunk);
+                continue;
+            }
+            sleeping = false;
+        }
+
+        updateSpans(chunk);
+        renderRamps(chunk);
+
+        if (worker != nullptr && chunk <= lateLead()) {
+            forEachSet(chunkData, numChannels, [this, chunk](auto lanes, Channel& channel, SampleType* const* data) {
+                [[maybe_unused]] const int track = (int)(&channel - channels.data());
+                MOORER_PROFILE_STAGE(firTaps);
+                firTaps<decltype(lanes)::value>(channel, data, chunk);
+            });
+
+            // whether it's quiet is only known once the worker is done with it
+            latePending = true;
+            lateMayBeQuiet = silentInput >= inFlight;
+            lateChunk = chunk;
+            lateChannels = numChannels;
+            worker->post([](void* engine) { static_cast<BasicMoorerReverbEngine*>(engine)->processLate(); }, this);
+
+            forEachSet(chunkData, numChannels, [this, chunk](auto lanes, Channel& channel, SampleType* const* data) {
+                [[maybe_unused]] const int track = (int)(&channel - channels.data());
+                MOORER_PROFILE_STAGE(mix);
+                mix<decltype(lanes)::value>(channel, data, chunk);
+            });
+
+            writePosition += (uint32_t)chunk;
+            continue;
+        }
+
+        forEachSet(chunkData, numChannels, [this, chunk](auto lanes, Channel& channel, SampleType* const* data) {
+            processChunk<decltype(lanes)::value>(channel, data, chunk);
+        });
+
+        // only look at the reverb's own level once no more input can arrive
+        const bool quiet = silentInput >= inFlight && isQuiet();
+        quietOutput = quiet ? quietOutput + chunk : 0;
+        writePosition += (uint32_t)chunk;
+
+        if (quietOutput >= quietSpan)
+            sleep();
+    }
+}
+
+/* everything fed in reaches the comb sum within this many samples */
+template <typename SampleType, typename Topology>
+int BasicMoorerReverbEngine<SampleType, Topology>::getInFlight() const
+{
+    return firOffsets[numTaps - 1] + (longestComb << stages) + resamplingLatency;
+}
+
+/* and everything in the combs and allpasses shows up in their output within this many */
+template <typename SampleType, typename Topology>
+int BasicMoorerReverbEngine<SampleType, Topology>::getQuietSpan() const
+{
+    int allpassSpan = 0;
+    for (int i = 0; i < numAllpasses; i++)
+        allpassSpan += allpassOffsets[i];
+    return ((longestComb + allpassSpan) << stages) + alignmentOffset;
+}
+
+template <typename SampleType, typename Topology>
+template <typename Function>
+void BasicMoorerReverbEngine<SampleType, Topology>::forEachSet(SampleType* const* chunkData, int numChannels, Function&& f)
+{
+    for (int set = 0; set < numLineSets; ++set) {
+        auto& channel = channels[(size_t)set];
+        if (channel.firstChannel >= numChannels)
+            break;
+
+        SampleType* const* data = &chunkData[channel.firstChannel];
+        switch (channel.lanes) {
+            case 8:  f(std::integral_constant<int, 8>(), channel, data); break;
+            case 4:  f(std::integral_constant<int, 4>(), channel, data); break;
+            case 2:  f(std::integral_constant<int, 2>(), channel, data); break;
+            default: f(std::integral_constant<int, 1>(), channel, data); break;
+        }
+    }
+}
+
+template <typename SampleType, typename Topology>
+int BasicMoorerReverbEngine<SampleType, Topology>::lateLead() const
+{
+    // the newest late sample the mix reads, behind the chunk's first, including mid-glide
+    const float nearest = predelayRamping ? std::min((float)alignmentOffset, alignmentStart) : (float)alignmentOffset;
+    return (int)(nearest - (float)resamplingLatency);
+}
+
+template <typename SampleType, typename Topology>
+void BasicMoorerReverbEngine<SampleType, Topology>::finishLate(int quietSpan)
+{
+    worker->collect();
+    latePending = false;
+
+    quietOutput = lateQuiet ? quietOutput + lateChunk : 0;
+    if (quietOutput >= quietSpan)
+        sleep();
+}
+
+/* the worker's job: the late stage of every set for the chunk last posted */
+template <typename SampleType, typename Topology>
+void BasicMoorerReverbEngine<SampleType, Topology>::processLate()
+{
+    // the profiler only takes events from the audio thread
+    forEachSet(chunkPointers.data(), lateChannels, [this](auto lanes, Channel& channel, SampleType* const*) {
+        processLate<decltype(lanes)::value>(channel, nullptr);
+    });
+    lateQuiet = lateMayBeQuiet && isQuiet();
+}
+
+template <typename SampleType, typename Topology>
+bool BasicMoorerReverbEngine<SampleType, Topology>::isSilent(SampleType* const* data, int numChannels, int numSamples) const
+{
+    // a flag rather than a running max, so the loop vectorises
+    for (int channel = 0; channel < numChannels; ++channel) {
+        int loud = 0;
+        for (int k = 0; k < numSamples; ++k)
+            loud |= std::abs(data[channel][k]) >= silenceThreshold;
+        if (loud != 0)
+            return false;
+    }
+    return true;
+}
+
+template <typename SampleType, typename Topology>
+bool BasicMoorerReverbEngine<SampleType, Topology>::isQuiet() const
+{
+    // the comb sum and every allpass output of the chunk just written
+    const Span& late = spans[stages];
+    for (int set = 0; set < numLineSets; ++set) {
+        const auto& channel = channels[(size_t)set];
+        for (int i = -1; i < numAllpasses; ++i) {
+            const Line* line = i < 0 ? &channel.combDelay : &channel.allpassDelays[i];
+            int loud = 0;
+            uint32_t dpw = late.position;
+            for (int done = 0; done < late.numSamples;) {
+                const int run = std::min(late.numSamples - done, line->contiguous(dpw));
+                const SampleType* x = line->at(dpw);
+                for (int k = 0; k < run*line->getNumLanes(); ++k)
+                    loud |= std::abs(x[k]) >= silenceThreshold;
+                dpw += (uint32_t)run;
+                done += run;
+            }
+            if (loud != 0)
+                return false;
+        }
+    }
+    return true;
+}
+
+template <typename SampleType, typename Topology>
+void BasicMoorerReverbEngine<SampleType, Topology>::sleep()
+{
+    reset();
+    sleeping = true;
+
+    // nothing is left to glide, so land on the targets now
+    reverbTimeRamp.snap(reverbTimeRamp.getTarget());
+    dampingRamp.snap(dampingRamp.getTarget());
+    wetMixRamp.snap(wetMixRamp.getTarget());
+    predelayRamp.snap(1.0f);
+}
+
+template <typename SampleType, typename Topology>
+void BasicMoorerReverbEngine<SampleType, Topology>::processAsleep(SampleType* const* data, int numChannels, int numSamples)
+{
+    // the lines are clear, so only the dry path is left
+    wetMixRamp.snap(wetMixRamp.getTarget());
+    reverbTimeRamp.snap(reverbTimeRamp.getTarget());
+    dampingRamp.snap(dampingRamp.getTarget());
+    predelayRamp.snap(1.0f);
+
+    const float dry = 1.0f - wetMixRamp.getCurrent();
+    for (int channel = 0; channel < numChannels; ++channel)
+        for (int k = 0; k < numSamples; ++k)
+            data[channel][k] *= dry;
+}
+
+template <typename SampleType, typename Topology>
+double BasicMoorerReverbEngine<SampleType, Topology>::getTailLengthSeconds(const MoorerReverbParameters& p)
+{
+    return getTailLengthSeconds(p, 20.0*std::log10((double)silenceThreshold));
+}
+
+template <typename SampleType, typename Topology>
+double BasicMoorerReverbEngine<SampleType, Topology>::getTailLengthSeconds(const MoorerReverbParameters& p, double decibels)
+{
+    const double predelay = std::fmin(std::fmax(p.predelay, 0.0f), Topology::maxPredelay);
+
+    /* the loudest frequency round each comb loop is rt*(1-g)*(1+g), so that
+       sets how many trips it takes to fall below the threshold */
+    double combTail = 0.0;
+    for (int i = 0; i < numCombs; i++) {
+        const double g = (double)p.damping*Topology::iirCoefficients[i];
+        const double loopGain = std::abs((double)p.reverbTime*(1.0 - g))*(1.0 + std::abs(g));
+        if (loopGain >= 1.0)
+            return std::numeric_limits<double>::infinity();
+        if (loopGain > 0.0)
+            combTail = std::max(combTail, decibels/(20.0*std::log10(loopGain))*Topology::iirDelayLengths[i]*maxChannelSpread);
+    }
+
+    double allpassTail = 0.0;
+    for (int i = 0; i < numAllpasses; i++)
+        allpassTail += decibels/(20.0*std::log10((double)Topology::allpassGain))*Topology::allpassDelays[i];
+
+    // the last tap into the combs, the combs and allpasses ringing out, then the alignment delay
+    return predelay + Topology::firDelayLengths[numTaps - 1] + combTail + allpassTail
+         + Topology::alignmentDelay + predelay;
+}
+
+template <typename SampleType, typename Topology>
+void BasicMoorerReverbEngine<SampleType, Topology>::renderRamps(int numSamples)
+{
+    // the combs read both arrays if either parameter is moving
+    const bool reverbTimeRamping = reverbTimeRamp.render(reverbTimeValues, numSamples);
+    const bool dampingRamping = dampingRamp.render(dampingValues, numSamples);
+    combsRamping = reverbTimeRamping || dampingRamping;
+
+    if (combsRamping && ! reverbTimeRamping)
+        std::fill(reverbTimeValues, reverbTimeValues + numSamples, reverbTimeRamp.getCurrent());
+    if (combsRamping && ! dampingRamping)
+        std::fill(dampingValues, dampingValues + numSamples, dampingRamp.getCurrent());
+    combReverbTime = reverbTimeRamp.getCurrent();
+    combDamping = dampingRamp.getCurrent();
+
+    // in eco mode the combs take every 2^stages-th value, from the first one on their rate
+    if (combsRamping && stages > 0) {
+        const Span& late = spans[stages];
+        const int first = (int)((late.position << stages) - writePosition);
+        for (int j = 0; j < late.numSamples; ++j) {
+            reverbTimeValues[j] = reverbTimeValues[first + (j << stages)];
+            dampingValues[j] = dampingValues[first + (j << stages)];
+        }
+    }
+
+    wetMixRamping = wetMixRamp.render(wetMixValues, numSamples);
+    predelayRamping = predelayRamp.render(predelayValues, numSamples);
+}
+
+template <typename SampleType, typename Topology>
+void BasicMoorerReverbEngine<SampleType, Topology>::updateSpans(int numSamples)
+{
+    // each halving keeps the even positions of the rate above it
+    spans[0] = { writePosition, numSamples };
+    for (int s = 0; s < stages; ++s) {
+        const Span& high = spans[s];
+        spans[s + 1] = { (high.position + 1) >> 1, (high.numSamples + 1 - (int)(high.position & 1)) >> 1 };
+    }
+}
+
+/* every stage below works on frames of `lanes` interleaved channels: index
+   math happens once per frame and the inner loops run over run*lanes samples */
+template <typename SampleType, typename Topology>
+template <int lanes>
+void BasicMoorerReverbEngine<SampleType, Topology>::processChunk(Channel& channel, SampleType* const* data, int numSamples)
+{
+    [[maybe_unused]] const int track = (int)(&channel - channels.data());
+
+    /* FIR DELAY TAPS */
+    {
+        MOORER_PROFILE_STAGE(firTaps);
+        firTaps<lanes>(channel, data, numSamples);
+    }
+    /* ============== */
+
+
+    processLate<lanes>(channel, profiler);
+
+
+    MOORER_PROFILE_STAGE(mix);
+    mix<lanes>(channel, data, numSamples);
+}
+
+/* the combs and allpasses, which only read the taps' output, so in pipelined
+   mode they run on the worker; lateProfiler is null there */
+template <typename SampleType, typename Topology>
+template <int lanes>
+void BasicMoorerReverbEngine<SampleType, Topology>::processLate(Channel& channel, [[maybe_unused]] StageProfiler* lateProfiler)
+{
+    [[maybe_unused]] const int track = (int)(&channel - channels.data());
+
+    // the combs and allpasses run over the chunk at their own rate
+    const Span& late = spans[stages];
+    const Line& combInput = stages > 0 ? channel.decimated[stages - 1] : channel.firDelay;
+
+    /* PARALLEL IIR COMB FILTERS */
+    {
+        MOORER_PROFILE_STAGE_ON(lateProfiler, combs);
+        for (int s = 0; s < stages; ++s)
+            decimate<lanes>(s == 0 ? channel.firDelay : channel.decimated[s - 1], channel.decimated[s], s);
+
+        if (usesCombBank()) {
+            // the bank only takes float lines
+            if constexpr (isFloat)
+                channel.combBank.process(combInput, channel.combDelay, late.position, late.numSamples,
+                                         combReverbTime, combDamping,
+                                         combsRamping ? reverbTimeValues : nullptr, combsRamping ? dampingValues : nullptr);
+        } else {
+            for (int i = 0; i < numCombs; i++)
+                combFilter<lanes>(channel.combDelays[i], combInput, channel.combOffsets[i*lanes], Topology::iirCoefficients[i], late);
+            sumCombs<lanes>(channel, late);
+        }
+    }
+    /* ========================= */
+
+
+    /* ALLPASS SECTION */
+    {
+        MOORER_PROFILE_STAGE_ON(lateProfiler, allpass);
+        for (int i = 0; i < numAllpasses; i++)
+            allpassFilter<lanes>(channel.allpassDelays[i], i == 0 ? channel.combDelay : channel.allpassDelays[i - 1],
+                                 allpassOffsets[i], late);
+
+        const Line& allpassOutput = channel.allpassDelays[numAllpasses - 1];
+        for (int s = stages - 1; s >= 0; --s)
+            interpolate<lanes>(s == stages - 1 ? allpassOutput : channel.interpolated[s + 1], channel.interpolated[s], s);
+    }
+    /* =============== */
+}
+
+template <typename SampleType, typename Topology>
+template <int lanes>
+void BasicMoorerReverbEngine<SampleType, Topology>::firTaps(Channel& channel, const SampleType* const* input, int numSamples)
+{
+    uint32_t dpw = writePosition;
+    for (int done = 0; done < numSamples;) {
+        const int run = std::min({ numSamples - done, channel.inputDelay.contiguous(dpw), channel.firDelay.contiguous(dpw) });
+        SampleType* in = channel.inputDelay.at(dpw);
+        SampleType* out = channel.firDelay.at(dpw);
+
+        for (int k = 0; k < run; ++k)
+            for (int c = 0; c < lanes; ++c)
+                in[k*lanes + c] = out[k*lanes + c] = input[c][done + k];
+
+        dpw += (uint32_t)run;
+        done += run;
+    }
+
+    if (predelayRamping) {
+        // taps glide between offsets, so each one needs its own fractional read
+        for (int k = 0; k < numSamples; ++k) {
+            dpw = writePosition + (uint32_t)k;
+            SampleType* out = channel.firDelay.at(dpw);
+            for (int i = 0; i < numTaps; i++) {
+                const float delay = firStart[i] + ((float)firOffsets[i] - firStart[i])*predelayValues[k];
+                for (int c = 0; c < lanes; ++c)
+                    out[c] += Topology::firCoefficients[i]*channel.inputDelay.readFractional(dpw, delay, c);
+            }
+        }
+        return;
+    }
+
+    for (int i = 0; i < numTaps; i++) {
+        const SampleType gain = Topology::firCoefficients[i];
+        dpw = writePosition;
+        uint32_t dpr = writePosition - (uint32_t)firOffsets[i];
+
+        for (int done = 0; done < numSamples;) {
+            const int run = std::min({ numSamples - done, channel.firDelay.contiguous(dpw), channel.inputDelay.contiguous(dpr) });
+            SampleType* out = channel.firDelay.at(dpw);
+            const SampleType* in = channel.inputDelay.at(dpr);
+
+            multiplyAdd(*kernels, out, in, gain, run*lanes);
+
+            dpw += (uint32_t)run;
+            dpr += (uint32_t)run;
+            done += run;
+        }
+    }
+}
+
+template <typename SampleType, typename Topology>
+template <int lanes>
+void BasicMoorerReverbEngine<SampleType, Topology>::combFilter(Line& comb, const Line& input, int delay, float coefficient, Span span)
+{
+    // y[n] = x[n-d] + g*y[n-d]
+    // lowpass feedback line: y[n] = (1-g)*(x[n] + g*x[n-1])
+    const SampleType rt = combReverbTime;
+    const SampleType feedback = (SampleType)combDamping*coefficient;
+    const SampleType lowpass = 1 - feedback;
+
+    uint32_t dpw = span.position;
+    uint32_t dpr = span.position - (uint32_t)delay;
+
+    /* the feedback is read a whole delay back, so a run no longer than the
+       delay only reads output written before it: every sample of the run is
+       independent of the others, and the kernels go along time at full width */
+    for (int done = 0; done < span.numSamples;) {
+        const int run = std::min({ span.numSamples - done, delay, comb.contiguous(dpw), input.contiguous(dpr),
+                                   comb.contiguous(dpr), comb.contiguous(dpr - 1) });
+        SampleType* out = comb.at(dpw);
+        const SampleType* xd = input.at(dpr);     // delayed input
+        const SampleType* fb = comb.at(dpr);      // previous output
+        const SampleType* fbPrev = comb.at(dpr - 1);
+
+        // uses comb output to dictate reverb time
+        if (! combsRamping)
+            ::comb(*kernels, out, xd, fb, fbPrev, rt, lowpass, feedback, run*lanes);
+        else
+            combRamped(*kernels, out, xd, fb, fbPrev, reverbTimeValues + done, dampingValues + done, coefficient, lanes, run);
+
+        dpw += (uint32_t)run;
+        dpr += (uint32_t)run;
+        done += run;
+    }
+}
+
+template <typename SampleType, typename Topology>
+template <int lanes>
+void BasicMoorerReverbEngine<SampleType, Topology>::sumCombs(Channel& channel, Span span)
+{
+    uint32_t dpw = span.position;
+    for (int done = 0; done < span.numSamples;) {
+        int run = std::min(span.numSamples - done, channel.combDelay.contiguous(dpw));
+        for (auto& comb : channel.combDelays)
+            run = std::min(run, comb.contiguous(dpw));
+
+        SampleType* combSum = channel.combDelay.at(dpw);
+        std::fill(combSum, combSum + run*lanes, SampleType(0));
+        for (auto& comb : channel.combDelays)
+            add(*kernels, combSum, comb.at(dpw), run*lanes);
+
+        dpw += (uint32_t)run;
+        done += run;
+    }
+}
+
+template <typename SampleType, typename Topology>
+template <int lanes>
+void BasicMoorerReverbEngine<SampleType, Topology>::allpassFilter(Line& output, const Line& input, int delay, Span span)
+{
+    // y[n] = -g*x[n] + x[n-d] + g*y[n-d]
+    uint32_t dpw = span.position;
+    uint32_t dpr = span.position - (uint32_t)delay;
+
+    for (int done = 0; done < span.numSamples;) {
+        const int run = std::min({ span.numSamples - done, output.contiguous(dpw), input.contiguous(dpw),
+                                   input.contiguous(dpr), output.contiguous(dpr) });
+        SampleType* out = output.at(dpw);
+        const SampleType* x = input.at(dpw);
+        const SampleType* xd = input.at(dpr);
+        const SampleType* yd = output.at(dpr);
+
+        allpass(*kernels, out, x, xd, yd, Topology::allpassGain, run*lanes);
+
+        dpw += (uint32_t)run;
+        dpr += (uint32_t)run;
+        done += run;
+    }
+}
+
+template <typename SampleType, typename Topology>
+template <int lanes>
+void BasicMoorerReverbEngine<SampleType, Topology>::decimate(const Line& input, Line& output, int stage)
+{
+    // one output per even position of the higher rate, each reading the 2*latency frames before it
+    const Span& span = spans[stage + 1];
+    if (span.numSamples == 0)
+        return;
+
+    // copy the window out and split it into its even and odd frames
+    const int numFrames = span.numSamples + Halfband::latency;
+    SampleType* x = resampleWindow.data();
+    SampleType* even = x + (size_t)(2*numFrames*lanes);
+    SampleType* odd = even + (size_t)(numFrames*lanes);
+    input.read((span.position << 1) - (uint32_t)(2*Halfband::latency), 2*numFrames, x);
+    for (int m = 0; m < numFrames; ++m) {
+        for (int c = 0; c < lanes; ++c) {
+            even[m*lanes + c] = x[2*m*lanes + c];
+            odd[m*lanes + c] = x[(2*m + 1)*lanes + c];
+        }
+    }
+
+    uint32_t dpw = span.position;
+    for (int done = 0; done < span.numSamples;) {
+        const int run = std::min(span.numSamples - done, output.contiguous(dpw));
+        Halfband::decimate<lanes>(even + done*lanes, odd + done*lanes, output.at(dpw), run);
+        dpw += (uint32_t)run;
+        done += run;
+    }
+}
+
+template <typename SampleType, typename Topology>
+template <int lanes>
+void BasicMoorerReverbEngine<SampleType, Topology>::interpolate(const Line& input, Line& output, int stage)
+{
+    // position p of the higher rate lines up with input frame p/2, delayed by the filter
+    const Span& span = spans[stage];
+    if (span.numSamples == 0)
+        return;
+
+    const int phase = (int)(span.position & 1);
+    const int numPairs = ((phase + span.numSamples - 1) >> 1) + 1;
+    SampleType* x = resampleWindow.data();
+    SampleType* even = x + (size_t)((numPairs + Halfband::latency)*lanes);
+    SampleType* y = even + (size_t)(numPairs*lanes);
+    input.read((span.position >> 1) - (uint32_t)Halfband::latency, numPairs + Halfband::latency, x);
+    Halfband::interpolate<lanes>(x, even, numPairs);
+
+    // interleave the filtered even outputs with the odd ones, starting from the span's phase
+    for (int q = 0; q < numPairs; ++q) {
+        for (int c = 0; c < lanes; ++c) {
+            y[2*q*lanes + c] = even[q*lanes + c];
+            y[(2*q + 1)*lanes + c] = x[(q + Halfband::numSideTaps)*lanes + c];
+        }
+    }
+
+    y += phase*lanes;
+    uint32_t dpw = span.position;
+    for (int done = 0; done < span.numSamples;) {
+        const int run = std::min(span.numSamples - done, output.contiguous(dpw));
+        std::copy(y + done*lanes, y + (done + run)*lanes, output.at(dpw));
+        dpw += (uint32_t)run;
+        done += run;
+    }
+}
+
+template <typename SampleType, typename Topology>
+template <int lanes>
+void BasicMoorerReverbEngine<SampleType, Topology>::mix(Channel& channel, SampleType* const* data, int numSamples)
+{
+    const float wet = wetMixRamp.getCurrent();
+    const float dry = 1.0f - wet;
+
+    // in eco mode the resamplers have already delayed the late path by part of the alignment
+    const Line& lateOutput = stages > 0 ? channel.interpolated[0] : channel.allpassDelays[numAllpasses - 1];
+    const int lateDelay = alignmentOffset - resamplingLatency;
+
+    if (predelayRamping || wetMixRamping) {
+        for (int k = 0; k < numSamples; ++k) {
+            const uint32_t dpw = writePosition + (uint32_t)k;
+            const float w = wetMixRamping ? wetMixValues[k] : wet;
+            const float alignment = alignmentStart + ((float)alignmentOffset - alignmentStart)*predelayValues[k]
+                                  - (float)resamplingLatency;
+            const SampleType* early = channel.firDelay.at(dpw);
+
+            for (int c = 0; c < lanes; ++c) {
+                const SampleType late = predelayRamping ? lateOutput.readFractional(dpw, alignment, c)
+                                                   : lateOutput.at(dpw - (uint32_t)lateDelay)[c];
+                data[c][k] = (1.0f - w)*data[c][k] + w*(Topology::outputGain*(early[c] + late));
+                if (wetTapChunk != nullptr)
+                    wetTapChunk[k] += wetTapGain*(early[c] + late);
+            }
+        }
+        return;
+    }
+
+    uint32_t dpw = writePosition;
+    uint32_t dpr = writePosition - (uint32_t)lateDelay;
+
+    for (int done = 0; done < numSamples;) {
+        const int run = std::min({ numSamples - done, channel.firDelay.contiguous(dpw), lateOutput.contiguous(dpr) });
+        const SampleType* early = channel.firDelay.at(dpw);
+        const SampleType* late = lateOutput.at(dpr);
+
+        if constexpr (lanes > 2)
+            mixLanes<lanes, SampleType>(data, done, early, late, dry, wet, Topology::outputGain, run);
+        else if (lanes == 2)
+            mixStereo(*kernels, data[0] + done, data[1] + done, early, late, dry, wet, Topology::outputGain, run);
+        else
+            mixMono(*kernels, data[0] + done, early, late, dry, wet, Topology::outputGain, run);
+
+        if (wetTapChunk != nullptr)
+            addWet<lanes>(wetTapChunk + done, early, late, wetTapGain, run);
+
+        dpw += (uint32_t)run;
+        dpr += (uint32_t)run;
+        done += run;
+    }
+}
+
+//==============================================================================
+namespace
+{
+    /* the state format: fixed-size fields as they are in memory (every target
+       the plugin ships for is little-endian), after a header saying what
+       layout the lines are in, and followed by a checksum of everything */
+    constexpr unsigned char stateMagic[4] = { 'M', 'R', 'V', 'S' };
+
+    // FNV-1a, which is plenty to catch a checkpoint cut short or damaged
+    uint32_t hashBytes(const void* data, size_t size, uint32_t hash = 2166136261u)
+    {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i)
+            hash = (hash ^ bytes[i])*16777619u;
+        return hash;
+    }
+
+    struct StateWriter
+    {
+        std::vector<unsigned char>& out;
+
+        void putBytes(const void* data, size_t size)
+        {
+            const auto* bytes = static_cast<const unsigned char*>(data);
+            out.insert(out.end(), bytes, bytes + size);
+        }
+
+        template <typename Value>
+        void put(const Value& value) { putBytes(&value, sizeof(value)); }
+    };
+
+    struct StateReader
+    {
+        const unsigned char* data;
+        size_t size, position {0};
+
+        bool getBytes(void* destination, size_t count)
+        {
+            if (count > size - position)
+                return false;
+            std::memcpy(destination, data + position, count);
+            position += count;
+            return true;
+        }
+
+        template <typename Value>
+        bool get(Value& value) { return getBytes(&value, sizeof(value)); }
+
+        /* false unless the next value is expected */
+        template <typename Value>
+        bool expect(const Value& expected)
+        {
+            Value value;
+            return get(value) && std::memcmp(&value, &expected, sizeof(value)) == 0;
+        }
+    };
+}
+
+/* what the lines' contents depend on: the topology's delays, and what the
+   engine was prepared with */
+template <typename SampleType, typename Topology>
+uint32_t BasicMoorerReverbEngine<SampleType, Topology>::getLayoutHash() const
+{
+    uint32_t hash = hashBytes(Topology::firDelayLengths, sizeof(Topology::firDelayLengths));
+    hash = hashBytes(Topology::iirDelayLengths, sizeof(Topology::iirDelayLengths), hash);
+    hash = hashBytes(Topology::allpassDelays, sizeof(Topology::allpassDelays), hash);
+
+    const int prepared[] = { (int)sizeof(SampleType), numChannelsPrepared, stages, numLineSets,
+                             usesCombBank() ? 1 : 0, interleaved ? 1 : 0 };
+    hash = hashBytes(prepared, sizeof(prepared), hash);
+    hash = hashBytes(&sampleRate, sizeof(sampleRate), hash);
+    const uint64_t numBytes = arena.getNumBytes();
+    return hashBytes(&numBytes, sizeof(numBytes), hash);
+}
+
+template <typename SampleType, typename Topology>
+void BasicMoorerReverbEngine<SampleType, Topology>::saveState(std::vector<unsigned char>& state)
+{
+    // a chunk in flight is finished, bookkeeping and all, as the next process() would
+    if (latePending)
+        finishLate(getQuietSpan());
+
+    state.clear();
+    StateWriter out {state};
+    out.putBytes(stateMagic, sizeof(stateMagic));
+    out.put(stateVersion);
+    out.put(getLayoutHash());
+
+    out.put(writePosition);
+    out.put(parameters);
+    out.put(predelay);
+    out.put(firStart);
+    out.put(alignmentStart);
+    for (const auto* ramp : { &reverbTimeRamp, &dampingRamp, &wetMixRamp, &predelayRamp })
+        out.put(ramp->getState());
+    out.put(silentInput);
+    out.put(quietOutput);
+    out.put(sleeping);
+
+    // asleep, the lines are all clear
+    if (! sleeping)
+        out.putBytes(arena.getData(), arena.getNumBytes());
+
+    out.put(hashBytes(state.data(), state.size()));
+}
+
+template <typename SampleType, typename Topology>
+bool BasicMoorerReverbEngine<SampleType, Topology>::restoreState(const unsigned char* state, size_t size)
+{
+    uint32_t checksum;
+    if (size < sizeof(checksum))
+        return false;
+    std::memcpy(&checksum, state + size - sizeof(checksum), sizeof(checksum));
+    if (checksum != hashBytes(state, size - sizeof(checksum)))
+        return false;
+
+    // everything is read into locals first, so a mismatch changes nothing
+    StateReader in {state, size - sizeof(checksum)};
+    unsigned char magic[sizeof(stateMagic)];
+    if (! in.getBytes(magic, sizeof(magic)) || std::memcmp(magic, stateMagic, sizeof(magic)) != 0
+         || ! in.expect(stateVersion) || ! in.expect(getLayoutHash()))
+        return false;
+
+    uint32_t savedPosition;
+    MoorerReverbParameters savedParameters;
+    float savedPredelay, savedFirStart[numTaps], savedAlignmentStart;
+    ParameterRamp::State ramps[4];
+    int savedSilentInput, savedQuietOutput;
+    bool savedSleeping;
+    if (! in.get(savedPosition) || ! in.get(savedParameters) || ! in.get(savedPredelay) || ! in.get(savedFirStart)
+         || ! in.get(savedAlignmentStart) || ! in.get(ramps) || ! in.get(savedSilentInput)
+         || ! in.get(savedQuietOutput) || ! in.get(savedSleeping))
+        return false;
+
+    const size_t lineBytes = savedSleeping ? 0 : arena.getNumBytes();
+    if (in.size - in.position != lineBytes)
+        return false;
+
+    if (worker != nullptr)
+        worker->collect();
+    latePending = false;
+
+    if (savedSleeping)
+        arena.clear();
+    else
+        in.getBytes(arena.getData(), lineBytes);
+
+    writePosition = savedPosition;
+    parameters = savedParameters;
+    predelay = savedPredelay;
+    updatePredelayOffsets();
+    std::copy(savedFirStart, savedFirStart + numTaps, firStart);
+    alignmentStart = savedAlignmentStart;
+    reverbTimeRamp.setState(ramps[0]);
+    dampingRamp.setState(ramps[1]);
+    wetMixRamp.setState(ramps[2]);
+    predelayRamp.setState(ramps[3]);
+    silentInput = savedSilentInput;
+    quietOutput = savedQuietOutput;
+    sleeping = savedSleeping;
+    return true;
+}
+
+template class BasicMoorerReverbEngine<float, MoorerTopology>;
+template class BasicMoorerReverbEngine<float, SchroederTopology>;
+template class BasicMoorerReverbEngine<float, DenseTopology>;
+template class BasicMoorerReverbEngine<double, MoorerTopology>;
+template class BasicMoorerReverbEngine<double, SchroederTopology>;
+template class BasicMoorerReverbEngine<double, DenseTopology>;
@@ -0,0 +1,348 @@
+/*
+  ==============================================================================
+
+    MoorerReverbEngine.h
+
+    Block-oriented processing core for the Moorer reverb. All delay offsets
+    are converted to whole samples up front (in prepare(), and again only when
+    the predelay moves), and each stage of the algorithm runs over contiguous
+    runs of its delay lines between wrap points instead of per sample.
+
+    The engine is a template on the sample type and the topology.
+    MoorerReverbEngine is the float one with Moorer's topology, whose inner
+    loops run through the dispatched DspKernels; the double one runs the
+    same arithmetic in plain loops for hosts that process in double
+    precision.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "CombBank.h"
+#include "DelayLineArena.h"
+#include "DspKernels.h"
+#include "Halfband.h"
+#include "MoorerTopology.h"
+#include "ParameterRamp.h"
+#include "PipelineWorker.h"
+#include "StageProfiler.h"
+
+#include <memory>
+#include <type_traits>
+
+/* one consistent set of parameter values, taken from the host once per block */
+struct MoorerReverbParameters
+{
+    float reverbTime {0.875f};
+    float predelay {0.02f};
+    float damping {0.7f};
+    float wetMix {1.0f};
+};
+
+/* everything that doesn't depend on the sample type or the topology */
+class MoorerReverbEngineBase
+{
+public:
+    /* blocks are split into chunks of at most this many samples, which bounds
+       how far ahead of the oldest read a stage is allowed to write */
+    static constexpr int maxChunkSize = 512;
+
+    /* scalar runs each comb over the chunk in turn; simd steps all six at once
+       in a CombBank, with identical results (float only: the double engine
+       always runs the combs one by one) */
+    enum class CombEngine { scalar, simd };
+
+    /* the largest eco mode factor setDecimation() takes */
+    static constexpr int maxDecimation = 4;
+
+    /* input below this (-120 dBFS) counts as silence; once the input has been
+       silent long enough for everything in flight to reach the combs, and the
+       reverb itself has stayed below it for a full loop, the lines are cleared
+       and silent chunks skip straight to the dry mix until signal returns */
+    static constexpr float silenceThreshold = 1.0e-6f;
+
+    /* the most channels packed into one set of interleaved lines */
+    static constexpr int maxLanes = CombBank::maxChannels;
+
+    /* each channel's comb delays are the topology's scaled by this, so that
+       the channels of a multichannel layout decorrelate; channels 0 and 1
+       keep the topology's own, so mono and stereo are unchanged */
+    static float channelSpread(int channel);
+    static constexpr float maxChannelSpread = 1.071f;
+
+protected:
+    static int toSamples(float delay);
+};
+
+template <typename SampleType, typename Topology = MoorerTopology>
+class BasicMoorerReverbEngine : public MoorerReverbEngineBase
+{
+public:
+    static_assert(std::is_same_v<SampleType, float> || std::is_same_v<SampleType, double>,
+                  "the engine is built for float and double");
+
+    static constexpr int numTaps = Topology::numTaps;
+    static constexpr int numCombs = Topology::numCombs;
+    static constexpr int numAllpasses = Topology::numAllpasses;
+    static_assert(numTaps > 0 && numAllpasses > 0 && numCombs > 0 && numCombs <= CombBank::maxCombs,
+                  "a topology needs a tap, an allpass and at most CombBank::maxCombs combs");
+
+    /* allocates everything prepare() needs for any rate up to maxSampleRate
+       and up to maxChannels channels, in any comb engine, eco mode or channel
+       packing (and starts the worker, if pipelined), so preparing within
+       those limits never allocates again; call it
+       before prepare(), which it leaves to be done */
+    void reserve(double maxSampleRate, int maxChannels);
+
+    /* clears all state and jumps straight to the last parameters set; both
+       wait for a pipelined chunk in flight first */
+    void prepare(double sampleRate, int numChannels);
+    void reset();
+
+    /* takes effect on the next prepare() */
+    void setCombEngine(CombEngine newEngine) { combEngine = newEngine; }
+    CombEngine getCombEngine() const { return combEngine; }
+
+    /* when preparing for two channels, store every delay line as interleaved
+       L/R frames and run both channels through each stage together. With more
+       channels, and the combs in the bank (the only place lanes can have comb
+       delays of their own), pack them into sets of up to maxLanes interleaved
+       lanes the same way, so each stage steps a whole set per vector. Takes
+       effect on the next prepare(); anything else runs each channel through
+       its own single-lane lines */
+    void setInterleaveChannels(bool shouldInterleave) { interleaveChannels = shouldInterleave; }
+    bool isInterleavingChannels() const { return interleaveChannels; }
+
+    /* eco mode: runs the combs and allpasses at sampleRate/factor (1, 2 or 4),
+       fed from the early reflections through halfband decimators and
+       interpolated back up before the mix; the early reflections stay at full
+       rate. Takes effect on the next prepare() */
+    void setDecimation(int factor);
+    int getDecimation() const { return decimation; }
+
+    /* pipelined mode: each chunk's combs and allpasses run on a worker thread
+       of the engine's own, while the calling thread mixes the chunk and goes
+       on to the next one's taps. The mix reads the late path at least the
+       29 ms alignment delay back, so it never needs the chunk the worker is
+       on, and nothing has to be delayed: the worker has until the next
+       chunk starts, and if it isn't done by then the caller finishes the
+       job itself. Chunks longer than the alignment delay (only at very low
+       sample rates) run inline. Takes effect on the next prepare() */
+    void setPipelined(bool shouldPipeline) { pipelined = shouldPipeline; }
+    bool isPipelined() const { return pipelined; }
+
+    /* chunks whose late stage the calling thread had to run or wait for */
+    int getNumLateChunks() const { return worker != nullptr ? worker->getNumLate() : 0; }
+
+    /* the inner loops run on the widest instruction set the CPU has unless
+       another is forced here, for testing (only while the audio thread is
+       stopped; all of them give the same output); returns false, changing
+       nothing, if isa can't run here. The double engine has no kernels to
+       dispatch, so this doesn't change it */
+    bool setIsa(DspKernels::Isa isa);
+    DspKernels::Isa getIsa() const { return kernels->isa; }
+
+    /* times every stage of every chunk into profiler while set (not owned);
+       only change it while the audio thread is stopped */
+    void setProfiler(StageProfiler* newProfiler) { profiler = newProfiler; }
+
+    /* new values are reached through short ramps rather than in one step */
+    void setParameters(const MoorerReverbParameters& newParameters);
+
+    /* processes numChannels channels in place; numChannels must not exceed
+       the count passed to prepare() (and must match it if channels are interleaved) */
+    void process(SampleType* const* channelData, int numChannels, int numSamples);
+
+    /* while set (not owned), process() also writes the wet signal alone to
+       destination, one sample per input sample: the early and late paths
+       summed as they go into the dry/wet mix, averaged over the channels.
+       For metering; set it from the audio thread before each process() */
+    void setWetTap(SampleType* destination) { wetTap = destination; }
+
+    /* true once the reverb has died away under silenceThreshold */
+    bool isSleeping() const { return sleeping; }
+
+    /* how long the output takes to decay below silenceThreshold after the
+       input stops (infinite if the combs don't decay at all) */
+    static double getTailLengthSeconds(const MoorerReverbParameters& parameters);
+
+    /* the same for falling by decibels (negative) from full scale: also how
+       long input has to be run in for the state to be that close to where
+       running all of it would have left it */
+    static double getTailLengthSeconds(const MoorerReverbParameters& parameters, double decibels);
+
+    /* delay offsets in samples, rounded the same way by every engine */
+    static int firOffset(int tap, float predelay, double sampleRate);
+    static int alignmentOffsetFor(float predelay, double sampleRate);
+    static int combOffset(int comb, double sampleRate);
+    static int combOffsetFor(int comb, int channel, double sampleRate);
+    static int allpassOffsetFor(int allpass, double sampleRate);
+
+    /* the delay lines' share of the arena as prepared */
+    size_t getDelayMemoryBytes() const { return arena.getNumBytes(); }
+
+    /* the engine's complete state, in a versioned binary format: every delay
+       line, the write position, the ramps and predelay glide, and the
+       silence tracking (no lines at all while asleep). An engine of the same
+       type, prepared at the same rate, channel count, comb engine, packing
+       and eco factor, can restore it and carry on bit-exactly, pipelined or
+       not; restoreState() returns false, changing nothing, if the layout
+       doesn't match or the data is damaged. Both wait for a pipelined chunk
+       in flight first, and neither is for a running audio thread */
+    void saveState(std::vector<unsigned char>& state);
+    bool restoreState(const unsigned char* state, size_t size);
+    static constexpr uint32_t stateVersion = 1;
+
+private:
+    static constexpr int maxStages = 2;  // halfband stages for maxDecimation
+    static constexpr bool isFloat = std::is_same_v<SampleType, float>;
+
+    using Line = BasicDelayLine<SampleType>;
+
+    /* the lines for one channel, or for a set of interleaved ones */
+    struct Channel
+    {
+        int firstChannel {0};
+        int lanes {1};
+
+        /* each comb's delay for each lane, comb by comb; they only differ
+           between lanes when the combs run in the bank */
+        int combOffsets[numCombs*maxLanes] {};
+        int longestComb {0};
+
+        Line inputDelay;
+        Line firDelay;
+        Line combDelays[numCombs];
+        CombBank combBank;
+        Line combDelay;
+        Line allpassDelays[numAllpasses];  // in series; the last is the late output
+
+        /* eco mode only: decimated[s] holds the early reflections at
+           sampleRate/2^(s+1), the last of them feeding the combs, and
+           interpolated[s] the allpasses' output brought back up to sampleRate/2^s */
+        Line decimated[maxStages];
+        Line interpolated[maxStages];
+    };
+
+    /* the samples of the current chunk at one rate */
+    struct Span
+    {
+        uint32_t position {0};
+        int numSamples {0};
+    };
+
+    std::vector<Channel> channels;      // only ever grows; the first numLineSets are in use
+    int numLineSets {0};
+    DelayLineArena arena;               // every line of every channel
+    std::vector<SampleType*> chunkPointers;  // one chunk of each channel
+    std::vector<SampleType> resampleWindow;  // the input a halfband pass reads, unwrapped
+
+    CombEngine combEngine {CombEngine::scalar};
+    const DspKernels* kernels {&DspKernels::best()};
+    StageProfiler* profiler {nullptr};
+    bool interleaveChannels {true};
+    bool interleaved {false};           // some set has more than one lane
+    int numChannelsPrepared {0};
+    int decimation {1};
+    int stages {0};                     // log2 of the decimation prepared for
+
+    /* spans[s] is the current chunk at sampleRate/2^s, so spans[stages] is
+       what the combs and allpasses run over */
+    Span spans[maxStages + 1];
+
+    double sampleRate {44100.0};
+    uint32_t writePosition {0};
+
+    MoorerReverbParameters parameters;
+    float predelay {0.02f};
+
+    /* delay offsets in samples; the comb and allpass ones are at the reduced
+       rate in eco mode, where the alignment delay is shortened by the
+       resamplers' latency */
+    int firOffsets[numTaps] {};
+    int longestComb {0};                // of any channel
+    int allpassOffsets[numAllpasses] {};
+    int alignmentOffset {0};
+    int resamplingLatency {0};
+
+    /* where the predelayed taps were when the predelay last changed; while
+       predelayRamp runs they glide from here to the offsets above */
+    float firStart[numTaps] {};
+    float alignmentStart {0.0f};
+
+    ParameterRamp reverbTimeRamp, dampingRamp, wetMixRamp, predelayRamp;
+
+    /* per-chunk parameter values, only valid while the matching flag is set */
+    float reverbTimeValues[maxChunkSize], dampingValues[maxChunkSize];
+    float wetMixValues[maxChunkSize], predelayValues[maxChunkSize];
+    bool combsRamping {false}, wetMixRamping {false}, predelayRamping {false};
+
+    /* the combs' gains for the chunk when they aren't ramping, taken with
+       the ramps so the late stage never reads the ramps themselves */
+    float combReverbTime {0.875f}, combDamping {0.7f};
+
+    // the chunk's part of the wet tap, if there is one, and what each channel adds to it
+    SampleType* wetTap {nullptr};
+    SampleType* wetTapChunk {nullptr};
+    SampleType wetTapGain {0};
+
+    void setPredelay(float seconds);
+    void updatePredelayOffsets();
+    float currentDelay(float start, int target) const;
+
+    bool usesCombBank() const { return isFloat && combEngine == CombEngine::simd; }
+
+    void configure(double newSampleRate, int numChannels, bool interleave);
+    void layOut();
+
+    void renderRamps(int numSamples);
+    void updateSpans(int numSamples);
+
+    /* silence tracking, in samples */
+    int silentInput {0}, quietOutput {0};
+    bool sleeping {false};
+
+    int getInFlight() const;
+    int getQuietSpan() const;
+    uint32_t getLayoutHash() const;
+
+    bool isSilent(SampleType* const* data, int numChannels, int numSamples) const;
+    bool isQuiet() const;
+    void sleep();
+    void processAsleep(SampleType* const* data, int numChannels, int numSamples);
+
+    /* pipelined mode: the chunk handed to the worker, and whether its
+       output can count towards sleeping (decided with the worker's isQuiet()) */
+    bool pipelined {false};
+    bool latePending {false}, lateMayBeQuiet {false}, lateQuiet {false};
+    int lateChunk {0}, lateChannels {0};
+
+    int lateLead() const;
+    void finishLate(int quietSpan);
+    void processLate();
+
+    template <typename Function> void forEachSet(SampleType* const* chunkData, int numChannels, Function&& f);
+    template <int lanes> void processChunk(Channel& channel, SampleType* const* data, int numSamples);
+    template <int lanes> void processLate(Channel& channel, StageProfiler* lateProfiler);
+    template <int lanes> void firTaps(Channel& channel, const SampleType* const* input, int numSamples);
+    template <int lanes> void combFilter(Line& comb, const Line& input, int delay, float coefficient, Span span);
+    template <int lanes> void sumCombs(Channel& channel, Span span);
+    template <int lanes> void allpassFilter(Line& output, const Line& input, int delay, Span span);
+    template <int lanes> void decimate(const Line& input, Line& output, int stage);
+    template <int lanes> void interpolate(const Line& input, Line& output, int stage);
+    template <int lanes> void mix(Channel& channel, SampleType* const* data, int numSamples);
+
+    // last, so it's stopped before anything its job touches is destroyed
+    std::unique_ptr<PipelineWorker> worker;
+};
+
+/* every sample type and shipped topology is compiled in MoorerReverbEngine.cpp */
+extern template class BasicMoorerReverbEngine<float, MoorerTopology>;
+extern template class BasicMoorerReverbEngine<float, SchroederTopology>;
+extern template class BasicMoorerReverbEngine<float, DenseTopology>;
+extern template class BasicMoorerReverbEngine<double, MoorerTopology>;
+extern template class BasicMoorerReverbEngine<double, SchroederTopology>;
+extern template class BasicMoorerReverbEngine<double, DenseTopology>;
+
+using MoorerReverbEngine = BasicMoorerReverbEngine<float>;
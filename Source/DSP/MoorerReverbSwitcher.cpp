@@ -0,0 +1,306 @@
+/*
+  ==============================================================================
+
+    MoorerReverbSwitcher.cpp
+
+  ==============================================================================
+*/
+
+#include "MoorerReverbSwitcher.h"
+
+#include <algorithm>
+
+//==============================================================================
+template <typename SampleType>
+template <typename Topology>
+struct MoorerReverbSwitcher<SampleType>::EngineFor : Engine
+{
+    EngineFor(const Configuration& configuration, CombEngine combEngine, StageProfiler* profiler)
+    {
+        this->configuration = configuration;
+        engine.setCombEngine(combEngine);
+        engine.setDecimation(configuration.decimation);
+        engine.setPipelined(configuration.pipelined);
+        engine.setProfiler(profiler);
+    }
+
+    void reserve(double maxSampleRate, int maxChannels) override { engine.reserve(maxSampleRate, maxChannels); }
+    void prepare(double sampleRate, int numChannels) override { engine.prepare(sampleRate, numChannels); }
+    void setParameters(const MoorerReverbParameters& parameters) override { engine.setParameters(parameters); }
+    void setProfiler(StageProfiler* profiler) override { engine.setProfiler(profiler); }
+    void setWetTap(SampleType* destination) override { engine.setWetTap(destination); }
+    void saveState(std::vector<unsigned char>& state) override { engine.saveState(state); }
+    bool restoreState(const unsigned char* state, size_t size) override { return engine.restoreState(state, size); }
+
+    void process(SampleType* const* channelData, int numChannels, int numSamples) override
+    {
+        engine.process(channelData, numChannels, numSamples);
+    }
+
+    BasicMoorerReverbEngine<SampleType, Topology> engine;
+};
+
+template <typename SampleType>
+MoorerReverbSwitcher<SampleType>::~MoorerReverbSwitcher()
+{
+    stop();
+    delete incoming.exchange(nullptr);
+    delete retired.exchange(nullptr);
+}
+
+template <typename SampleType>
+void MoorerReverbSwitcher<SampleType>::setProfiler(StageProfiler* newProfiler)
+{
+    profiler = newProfiler;
+    if (current != nullptr)
+        current->setProfiler(profiler);
+}
+
+template <typename SampleType>
+std::unique_ptr<typename MoorerReverbSwitcher<SampleType>::Engine>
+MoorerReverbSwitcher<SampleType>::build(const Configuration& configuration) const
+{
+    auto engine = withTopology(configuration.topology, [&](auto topology) -> std::unique_ptr<Engine> {
+        return std::make_unique<EngineFor<decltype(topology)>>(configuration, combEngine, profiler);
+    });
+
+    if (maxSampleRate > 0.0)
+        engine->reserve(maxSampleRate, maxChannels);
+    return engine;
+}
+
+template <typename SampleType>
+void MoorerReverbSwitcher<SampleType>::reserve(const Configuration& configuration, double newMaxSampleRate, int newMaxChannels)
+{
+    std::lock_guard<std::mutex> lock(buildLock);
+
+    maxSampleRate = newMaxSampleRate;
+    maxChannels = newMaxChannels;
+
+    if (current == nullptr || current->configuration != configuration)
+        current = build(configuration);
+    else
+        current->reserve(maxSampleRate, maxChannels);
+
+    built = requested = active = pack(configuration);
+}
+
+template <typename SampleType>
+void MoorerReverbSwitcher<SampleType>::prepare(const Configuration& configuration, double newSampleRate, int newNumChannels,
+                                               int newMaxBlockSize, const MoorerReverbParameters& newParameters)
+{
+    // waits out a build in progress, which would be for the old rate anyway
+    std::lock_guard<std::mutex> lock(buildLock);
+
+    // a switch in flight is dropped; an engine already built this way is kept, so it re-prepares without allocating
+    delete incoming.exchange(nullptr);
+    delete retired.exchange(nullptr);
+    fadingOut.reset();
+
+    if (current == nullptr || current->configuration != configuration)
+        current = build(configuration);
+
+    parameters = newParameters;
+    reverbTime = parameters.reverbTime;
+    predelay = parameters.predelay;
+    damping = parameters.damping;
+    wetMix = parameters.wetMix;
+
+    current->setParameters(parameters);
+    current->prepare(newSampleRate, newNumChannels);
+
+    sampleRate = newSampleRate;
+    numChannels = newNumChannels;
+    built = requested = active = pack(configuration);
+
+    maxBlockSize = std::max(1, newMaxBlockSize);
+    scratch.resize((size_t)(maxBlockSize*numChannels));
+    scratchTap.resize((size_t)maxBlockSize);
+    scratchPointers.resize((size_t)numChannels);
+    chunkPointers.resize((size_t)numChannels);
+    for (int channel = 0; channel < numChannels; ++channel)
+        scratchPointers[(size_t)channel] = scratch.data() + channel*maxBlockSize;
+    fadeLength = std::max(1, (int)(crossfadeSeconds*sampleRate));
+
+    if (! running) {
+        running = true;
+        thread = std::thread([this] { run(); });
+    }
+}
+
+template <typename SampleType>
+void MoorerReverbSwitcher<SampleType>::requestConfiguration(const Configuration& configuration)
+{
+    const int packed = pack(configuration);
+    requested.store(packed, std::memory_order_relaxed);
+
+    // repeated on every call until the background thread has built it, in case one slipped past its wait
+    if (packed != built.load(std::memory_order_relaxed))
+        wake.notify_one();
+}
+
+template <typename SampleType>
+void MoorerReverbSwitcher<SampleType>::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeLock);
+        running = false;
+    }
+    wake.notify_one();
+
+    if (thread.joinable())
+        thread.join();
+}
+
+template <typename SampleType>
+bool MoorerReverbSwitcher<SampleType>::hasWork() const
+{
+    return retired.load(std::memory_order_acquire) != nullptr
+        || requested.load(std::memory_order_relaxed) != built.load(std::memory_order_relaxed);
+}
+
+template <typename SampleType>
+void MoorerReverbSwitcher<SampleType>::run()
+{
+    while (running) {
+        {
+            std::lock_guard<std::mutex> lock(buildLock);
+
+            // whatever the audio thread has finished fading out
+            delete retired.exchange(nullptr, std::memory_order_acquire);
+
+            const int wanted = requested.load(std::memory_order_relaxed);
+            if (wanted != built.load(std::memory_order_relaxed)) {
+                auto engine = build(unpack(wanted));
+                engine->setParameters({ reverbTime, predelay, damping, wetMix });
+                engine->prepare(sampleRate, numChannels);
+                built.store(wanted, std::memory_order_relaxed);
+
+                // a newer engine replaces one the audio thread hasn't taken yet
+                delete incoming.exchange(engine.release(), std::memory_order_acq_rel);
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(wakeLock);
+        wake.wait(lock, [this] { return ! running || hasWork(); });
+    }
+}
+
+//==============================================================================
+template <typename SampleType>
+void MoorerReverbSwitcher<SampleType>::setParameters(const MoorerReverbParameters& newParameters)
+{
+    parameters = newParameters;
+    reverbTime.store(parameters.reverbTime, std::memory_order_relaxed);
+    predelay.store(parameters.predelay, std::memory_order_relaxed);
+    damping.store(parameters.damping, std::memory_order_relaxed);
+    wetMix.store(parameters.wetMix, std::memory_order_relaxed);
+
+    if (current != nullptr)
+        current->setParameters(parameters);
+    if (fadingOut != nullptr)
+        fadingOut->setParameters(parameters);
+}
+
+template <typename SampleType>
+void MoorerReverbSwitcher<SampleType>::takeIncoming()
+{
+    // one switch at a time, and only once the last engine faded out has been collected
+    if (fadingOut != nullptr || retired.load(std::memory_order_acquire) != nullptr)
+        return;
+
+    if (Engine* next = incoming.exchange(nullptr, std::memory_order_acq_rel)) {
+        fadingOut = std::move(current);
+        current.reset(next);
+        current->setParameters(parameters);
+        fadePosition = 0;
+        active.store(pack(current->configuration), std::memory_order_relaxed);
+    }
+}
+
+template <typename SampleType>
+void MoorerReverbSwitcher<SampleType>::process(SampleType* const* channelData, int numChannelsToProcess, int numSamples)
+{
+    if (current == nullptr)
+        return;
+
+    // as with requests, until the background thread has freed it
+    if (retired.load(std::memory_order_relaxed) != nullptr)
+        wake.notify_one();
+
+    takeIncoming();
+
+    if (fadingOut == nullptr) {
+        current->setWetTap(wetTap);
+        current->process(channelData, numChannelsToProcess, numSamples);
+    } else
+        crossfade(channelData, std::min(numChannelsToProcess, numChannels), numSamples);
+}
+
+template <typename SampleType>
+void MoorerReverbSwitcher<SampleType>::crossfade(SampleType* const* channelData, int numChannelsToProcess, int numSamples)
+{
+    for (int offset = 0; offset < numSamples;) {
+        const int chunk = std::min(maxBlockSize, numSamples - offset);
+        for (int channel = 0; channel < numChannelsToProcess; ++channel) {
+            chunkPointers[(size_t)channel] = channelData[channel] + offset;
+            std::copy(chunkPointers[(size_t)channel], chunkPointers[(size_t)channel] + chunk, scratchPointers[(size_t)channel]);
+        }
+
+        // the outgoing engine runs on a copy of the input, then the two are mixed linearly
+        SampleType* tap = wetTap != nullptr ? wetTap + offset : nullptr;
+        fadingOut->setWetTap(tap != nullptr ? scratchTap.data() : nullptr);
+        fadingOut->process(scratchPointers.data(), numChannelsToProcess, chunk);
+        current->setWetTap(tap);
+        current->process(chunkPointers.data(), numChannelsToProcess, chunk);
+
+        auto fade = [&](SampleType* out, const SampleType* old) {
+            for (int k = 0; k < chunk; ++k) {
+                const SampleType gain = (SampleType)std::min(fadePosition + k, fadeLength)/(SampleType)fadeLength;
+                out[k] = old[k] + gain*(out[k] - old[k]);
+            }
+        };
+        for (int channel = 0; channel < numChannelsToProcess; ++channel)
+            fade(chunkPointers[(size_t)channel], scratchPointers[(size_t)channel]);
+        if (tap != nullptr)
+            fade(tap, scratchTap.data());
+
+        fadePosition += chunk;
+        offset += chunk;
+
+        if (fadePosition >= fadeLength) {
+            // the background thread frees it
+            retired.store(fadingOut.release(), std::memory_order_release);
+
+            if (offset < numSamples) {
+                for (int channel = 0; channel < numChannelsToProcess; ++channel)
+                    chunkPointers[(size_t)channel] = channelData[channel] + offset;
+                current->setWetTap(wetTap != nullptr ? wetTap + offset : nullptr);
+                current->process(chunkPointers.data(), numChannelsToProcess, numSamples - offset);
+            }
+            return;
+        }
+    }
+}
+
+template <typename SampleType>
+bool MoorerReverbSwitcher<SampleType>::saveState(std::vector<unsigned char>& state)
+{
+    if (current == nullptr || fadingOut != nullptr || incoming.load(std::memory_order_acquire) != nullptr)
+        return false;
+
+    current->saveState(state);
+    return true;
+}
+
+template <typename SampleType>
+bool MoorerReverbSwitcher<SampleType>::restoreState(const unsigned char* state, size_t size)
+{
+    if (current == nullptr || fadingOut != nullptr || incoming.load(std::memory_order_acquire) != nullptr)
+        return false;
+
+    return current->restoreState(state, size);
+}
+
+template class MoorerReverbSwitcher<float>;
+template class MoorerReverbSwitcher<double>;
@@ -0,0 +1,167 @@
+/*
+  ==============================================================================
+
+    MoorerReverbSwitcher.h
+
+    Holds the engine being heard, and swaps in a differently built one (a new
+    topology, eco factor or pipelining) without stopping the audio. A background thread
+    builds and prepares the new engine, which needs allocating, and hands it
+    over through an atomic pointer; the audio thread crossfades from the old
+    one to it and hands the old one back the same way to be freed. Nothing
+    on the audio thread allocates, frees or locks.
+
+    The background thread sleeps on a condition variable until there is an
+    engine to build or free. The audio thread signals it without taking the
+    lock, so a signal can slip in between the thread's check and its wait;
+    rather than have the thread poll for that, the audio thread signals
+    again on every block for as long as the work is still waiting.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "MoorerReverbEngine.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+template <typename SampleType>
+class MoorerReverbSwitcher
+{
+public:
+    using CombEngine = MoorerReverbEngineBase::CombEngine;
+
+    /* what an engine is built with, as opposed to its parameters */
+    struct Configuration
+    {
+        TopologyPreset topology {TopologyPreset::moorer};
+        int decimation {1};
+        bool pipelined {false};
+
+        bool operator==(const Configuration& other) const
+        {
+            return topology == other.topology && decimation == other.decimation && pipelined == other.pipelined;
+        }
+        bool operator!=(const Configuration& other) const { return ! (*this == other); }
+    };
+
+    static constexpr double crossfadeSeconds = 0.03;
+
+    MoorerReverbSwitcher() = default;
+    ~MoorerReverbSwitcher();
+
+    /* applied to every engine built from now on; only while the audio thread is stopped */
+    void setCombEngine(CombEngine newEngine) { combEngine = newEngine; }
+    void setProfiler(StageProfiler* newProfiler);
+
+    /* builds the engine for configuration now and reserves it for rates up
+       to maxSampleRate and up to maxChannels, which every later engine is
+       reserved for too; call it before prepare() to keep re-preparing the
+       first engine from allocating */
+    void reserve(const Configuration& configuration, double maxSampleRate, int maxChannels);
+
+    /* makes configuration current straight away, cancelling any switch in
+       flight, and starts the background thread; call while the audio thread
+       is stopped */
+    void prepare(const Configuration& configuration, double sampleRate, int numChannels, int maxBlockSize,
+                 const MoorerReverbParameters& parameters);
+
+    /* any thread, lock-free: has the background thread build an engine for
+       configuration, which process() then crossfades to; a newer request
+       replaces one that hasn't been heard yet */
+    void requestConfiguration(const Configuration& configuration);
+
+    /* the engine that process() is running (or fading to) */
+    Configuration getActiveConfiguration() const { return unpack(active.load()); }
+
+    /* audio thread */
+    void setParameters(const MoorerReverbParameters& newParameters);
+
+    /* the engine's setWetTap(), crossfaded along with the output; destination
+       needs room for every sample of the next process() call */
+    void setWetTap(SampleType* destination) { wetTap = destination; }
+
+    void process(SampleType* const* channelData, int numChannels, int numSamples);
+
+    /* the current engine's saveState() and restoreState(), from the thread
+       that processes; false while a switch is in flight, since a crossfade
+       isn't saved */
+    bool saveState(std::vector<unsigned char>& state);
+    bool restoreState(const unsigned char* state, size_t size);
+
+private:
+    /* any topology's engine behind one interface, so it can be handed over whole */
+    struct Engine
+    {
+        virtual ~Engine() = default;
+        virtual void reserve(double maxSampleRate, int maxChannels) = 0;
+        virtual void prepare(double sampleRate, int numChannels) = 0;
+        virtual void setParameters(const MoorerReverbParameters& parameters) = 0;
+        virtual void process(SampleType* const* channelData, int numChannels, int numSamples) = 0;
+        virtual void setProfiler(StageProfiler* profiler) = 0;
+        virtual void setWetTap(SampleType* destination) = 0;
+        virtual void saveState(std::vector<unsigned char>& state) = 0;
+        virtual bool restoreState(const unsigned char* state, size_t size) = 0;
+
+        Configuration configuration;
+    };
+
+    template <typename Topology>
+    struct EngineFor;
+
+    std::unique_ptr<Engine> build(const Configuration& configuration) const;
+
+    // the decimation is at most 4, so it fits below the pipelining bit
+    static constexpr int pack(const Configuration& c) { return (int)c.topology*16 + (c.pipelined ? 8 : 0) + c.decimation; }
+    static Configuration unpack(int packed) { return { (TopologyPreset)(packed/16), packed % 8, (packed & 8) != 0 }; }
+
+    CombEngine combEngine {CombEngine::scalar};
+    StageProfiler* profiler {nullptr};
+    double maxSampleRate {0.0};
+    int maxChannels {0};
+
+    // audio thread while it runs, otherwise whoever prepares
+    std::unique_ptr<Engine> current, fadingOut;
+    MoorerReverbParameters parameters;
+    int fadePosition {0}, fadeLength {1};
+    int maxBlockSize {0};
+    std::vector<SampleType> scratch;     // the outgoing engine's copy of the input
+    SampleType* wetTap {nullptr};
+    std::vector<SampleType> scratchTap;  // and its wet tap
+    std::vector<SampleType*> scratchPointers, chunkPointers;
+
+    // background thread -> audio thread, and back
+    std::atomic<Engine*> incoming {nullptr}, retired {nullptr};
+    std::atomic<int> requested {pack({})}, active {pack({})};
+
+    // the parameters a new engine starts from; they only need to be near the latest
+    std::atomic<float> reverbTime {0.875f}, predelay {0.02f}, damping {0.7f}, wetMix {1.0f};
+
+    // held by the background thread while it builds, so prepare() can't change the rate under it
+    std::mutex buildLock;
+    std::atomic<int> built {pack({})};   // the newest engine, current or incoming
+    double sampleRate {0.0};
+    int numChannels {0};
+
+    std::atomic<bool> running {false};
+    std::thread thread;
+    std::mutex wakeLock;
+    std::condition_variable wake;
+
+    bool hasWork() const;
+    void run();
+    void stop();
+    void takeIncoming();
+    void crossfade(SampleType* const* channelData, int numChannels, int numSamples);
+
+    MoorerReverbSwitcher(const MoorerReverbSwitcher&) = delete;
+    MoorerReverbSwitcher& operator=(const MoorerReverbSwitcher&) = delete;
+};
+
+extern template class MoorerReverbSwitcher<float>;
+extern template class MoorerReverbSwitcher<double>;
@@ -0,0 +1,95 @@
+/*
+  ==============================================================================
+
+    MoorerTopology.h
+
+    Delay times and gains of the reverb, shared by every engine that renders it.
+
+    A topology is a type holding only constants: the engine takes it as a
+    template argument, so the tap, comb and allpass counts size its arrays
+    and bound its loops at compile time. MoorerTopology is the original
+    design; the other two trade density against CPU around it.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+struct MoorerTopology
+{
+    /* these delay times and gains are recommended for the 7-tap reverb in
+       [1] J. A. Moorer, "About This Reverberation Business," Computer Music Journal,
+           vol. 3, no. 2, pp. 13-28 (1979 Jun.). https://doi.org/10.2307/3680280.
+     */
+    static constexpr int numTaps = 6;
+    static constexpr int numCombs = 6;
+    static constexpr int numAllpasses = 1;
+
+    // 0.0199, 0.0354, 0.0389, 0.0414, 0.0699, 0.0796 w/ compensation for predelay
+    static constexpr float firDelayLengths[numTaps] = { 0.0f, 0.0155f, 0.019f,
+                                                        0.0215f, 0.05f, 0.0597f };
+    static constexpr float firCoefficients[numTaps] = { 0.921f,  0.818f, 0.635f,
+                                                        0.719f, 0.267f, 0.242f };
+
+    // Moorer, 1965: 0.03, 0.034, 0.037, 0.041
+    static constexpr float iirDelayLengths[numCombs] = { 0.05f,  0.056f, 0.061f,
+                                                         0.068f, 0.072f, 0.078f };
+    // damping is 0-1.8 to map these values to 0-0.99
+    static constexpr float iirCoefficients[numCombs] = { 0.46f, 0.48f, 0.5f, 0.52f, 0.53f, 0.55f };
+
+    // in series, all with the same gain
+    static constexpr float allpassDelays[numAllpasses] = { 0.006f };
+    static constexpr float allpassGain = 0.7f;
+
+    /* this delay lines up first late reflection with the last early reflection (as recommended in [1]) */
+    static constexpr float alignmentDelay = 0.029f;
+
+    static constexpr float outputGain = 0.15f;
+    static constexpr float maxPredelay = 0.1f;
+};
+
+/* Schroeder's four combs and two allpasses behind Moorer's early taps: the
+   cheapest, and the most metallic on transients. Anything not redeclared
+   here is Moorer's */
+struct SchroederTopology : MoorerTopology
+{
+    static constexpr int numCombs = 4;
+    static constexpr int numAllpasses = 2;
+
+    // M. R. Schroeder, "Natural Sounding Artificial Reverberation," JAES, vol. 10, no. 3 (1962)
+    static constexpr float iirDelayLengths[numCombs] = { 0.0297f, 0.0371f, 0.0411f, 0.0437f };
+    static constexpr float iirCoefficients[numCombs] = { 0.46f, 0.48f, 0.5f, 0.52f };
+
+    static constexpr float allpassDelays[numAllpasses] = { 0.005f, 0.0017f };
+};
+
+/* eight combs and four allpasses: a smoother, denser tail for roughly a
+   third more CPU than Moorer's */
+struct DenseTopology : MoorerTopology
+{
+    static constexpr int numCombs = 8;
+    static constexpr int numAllpasses = 4;
+
+    // Moorer's spread, filled in
+    static constexpr float iirDelayLengths[numCombs] = { 0.0497f, 0.0531f, 0.0563f, 0.0601f,
+                                                         0.0647f, 0.0683f, 0.0733f, 0.0781f };
+    static constexpr float iirCoefficients[numCombs] = { 0.45f, 0.46f, 0.48f, 0.49f,
+                                                         0.5f,  0.52f, 0.53f, 0.55f };
+
+    static constexpr float allpassDelays[numAllpasses] = { 0.006f, 0.0043f, 0.0031f, 0.0019f };
+};
+
+/* the topologies the processor offers, in the order its parameter lists them */
+enum class TopologyPreset { moorer, schroeder, dense };
+
+/* calls function with a value of the preset's topology type */
+template <typename Function>
+auto withTopology(TopologyPreset preset, Function&& function)
+{
+    switch (preset) {
+        case TopologyPreset::schroeder: return function(SchroederTopology {});
+        case TopologyPreset::dense:     return function(DenseTopology {});
+        case TopologyPreset::moorer:    break;
+    }
+    return function(MoorerTopology {});
+}
@@ -0,0 +1,101 @@
+/*
+  ==============================================================================
+
+    ParameterRamp.h
+
+    Smooths one parameter towards its latest target and renders the result a
+    chunk at a time into a plain array, so the DSP kernels never touch the
+    (atomic) host parameters. A settled ramp renders nothing and the caller
+    falls back to the scalar value.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+class ParameterRamp
+{
+public:
+    enum class Shape { linear, exponential };
+
+    void reset(double sampleRate, double rampSeconds, Shape newShape)
+    {
+        shape = newShape;
+        rampLength = std::max(1, (int)(rampSeconds*sampleRate));
+        // exponential ramps cover ~99.9% of the distance in rampSeconds
+        decay = (float)std::exp(-6.9/(double)rampLength);
+        snap(target);
+    }
+
+    /* jumps straight to value, e.g. when (re)starting playback */
+    void snap(float value)
+    {
+        current = target = value;
+        stepsLeft = 0;
+    }
+
+    void setTarget(float newTarget)
+    {
+        if (newTarget == target)
+            return;
+
+        target = newTarget;
+        stepsLeft = rampLength;
+        step = (target - current)/(float)rampLength;
+    }
+
+    /* everything a glide in progress depends on besides the rate, so an
+       engine's state can be saved and picked up again exactly */
+    struct State
+    {
+        float current, target, step;
+        int stepsLeft;
+    };
+
+    State getState() const { return { current, target, step, stepsLeft }; }
+    void setState(const State& state)
+    {
+        current = state.current;
+        target = state.target;
+        step = state.step;
+        stepsLeft = state.stepsLeft;
+    }
+
+    bool isRamping() const   { return stepsLeft > 0; }
+    float getCurrent() const { return current; }
+    float getTarget() const  { return target; }
+
+    /* writes the next numSamples values into dest, or returns false without
+       touching dest if the ramp has settled on its target */
+    bool render(float* dest, int numSamples)
+    {
+        if (stepsLeft <= 0)
+            return false;
+
+        int k = 0;
+        if (shape == Shape::linear) {
+            for (; k < numSamples && stepsLeft > 0; ++k, --stepsLeft)
+                dest[k] = (current += step);
+        } else {
+            for (; k < numSamples && stepsLeft > 0; ++k, --stepsLeft)
+                dest[k] = (current = target + (current - target)*decay);
+        }
+
+        if (stepsLeft <= 0)
+            current = target;
+
+        for (; k < numSamples; ++k)
+            dest[k] = target;
+
+        return true;
+    }
+
+private:
+    Shape shape {Shape::linear};
+    float current {0.0f}, target {0.0f};
+    float step {0.0f}, decay {0.0f};
+    int rampLength {1}, stepsLeft {0};
+};
@@ -0,0 +1,129 @@
+/*
+  ==============================================================================
+
+    PipelineWorker.cpp
+
+  ==============================================================================
+*/
+
+#include "PipelineWorker.h"
+
+#include <cstdint>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+ #include <xmmintrin.h>
+#endif
+
+namespace
+{
+    /* the thread's floating-point control word, which holds the flush-to-zero
+       and denormals-are-zero bits the host (or ScopedNoDenormals) set */
+    std::uint64_t getFloatMode()
+    {
+       #if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+        return _mm_getcsr();
+       #elif defined(__aarch64__)
+        std::uint64_t fpcr;
+        asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+        return fpcr;
+       #else
+        return 0;
+       #endif
+    }
+
+    void setFloatMode([[maybe_unused]] std::uint64_t mode)
+    {
+       #if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+        _mm_setcsr((unsigned int)mode);
+       #elif defined(__aarch64__)
+        asm volatile("msr fpcr, %0" : : "r"(mode));
+       #endif
+    }
+
+    /* tells the core this is a spin-wait, so a sibling hyperthread gets the pipeline */
+    inline void spinPause()
+    {
+       #if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+        _mm_pause();
+       #elif defined(__aarch64__)
+        asm volatile("yield");
+       #endif
+    }
+}
+
+PipelineWorker::PipelineWorker()
+{
+    thread = std::thread([this] { run(); });
+}
+
+PipelineWorker::~PipelineWorker()
+{
+    collect();
+    {
+        // under the lock, so the worker can't check it and then miss the signal
+        std::lock_guard<std::mutex> lock(wakeLock);
+        alive = false;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+void PipelineWorker::post(Job newJob, void* newContext)
+{
+    job = newJob;
+    context = newContext;
+    floatMode = getFloatMode();
+    state.store(posted, std::memory_order_release);
+    wake.notify_one();
+}
+
+void PipelineWorker::collect()
+{
+    int expected = posted;
+    if (state.compare_exchange_strong(expected, claimed, std::memory_order_acq_rel)) {
+        // the worker never got to it
+        numLate.fetch_add(1, std::memory_order_relaxed);
+        job(context);
+    } else if (expected == idle) {
+        return;
+    } else if (expected == claimed) {
+        numLate.fetch_add(1, std::memory_order_relaxed);
+
+        const auto deadline = std::chrono::steady_clock::now() + spinLimit;
+        while (state.load(std::memory_order_acquire) != finished) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                // the worker has been held up, maybe by this very thread on its core: get out of its way
+                numStalled.fetch_add(1, std::memory_order_relaxed);
+                std::unique_lock<std::mutex> lock(wakeLock);
+                done.wait(lock, [this] { return state.load(std::memory_order_acquire) == finished; });
+                break;
+            }
+            spinPause();
+        }
+    }
+
+    state.store(idle, std::memory_order_release);
+}
+
+void PipelineWorker::run()
+{
+    std::uint64_t currentMode = getFloatMode();
+    while (alive) {
+        int expected = posted;
+        if (state.compare_exchange_strong(expected, claimed, std::memory_order_acq_rel)) {
+            if (floatMode != currentMode)
+                setFloatMode(currentMode = floatMode);
+            job(context);
+            {
+                // under the lock, so a collect() that has given up spinning can't miss it
+                std::lock_guard<std::mutex> lock(wakeLock);
+                state.store(finished, std::memory_order_release);
+            }
+            done.notify_one();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeLock);
+        wake.wait(lock, [this] { return state.load(std::memory_order_acquire) == posted || ! alive; });
+    }
+}
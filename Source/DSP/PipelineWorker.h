@@ -0,0 +1,86 @@
+/*
+  ==============================================================================
+
+    PipelineWorker.h
+
+    A background thread that runs one job at a time for the audio thread.
+    Handing a job over and taking it back never block the audio thread: the
+    job moves through an atomic state, and whichever thread claims it first
+    runs it. If the worker hasn't started a job by the time the audio thread
+    needs it done, the audio thread runs it itself; if the worker is partway
+    through, the audio thread waits out the rest, which is never longer than
+    running it itself would have taken.
+
+    That wait spins only briefly. The worker isn't pinned, but it can still
+    be sharing a core with the audio thread, which would then spin against
+    the very thread it waits for; so after spinLimit the audio thread blocks
+    until the worker signals that it's done, which lets the worker run.
+
+    Between jobs the worker sleeps on a condition variable that the audio
+    thread signals without taking the lock. A signal that slips in between
+    the worker's check and its wait is lost; collect() then finds the job
+    still posted and runs it inline, and the next post() signals again, so
+    the worker never needs to wake on a timer.
+
+    A job runs in the floating-point mode of the thread that posted it, so
+    denormals are flushed (or not) on the worker just as they would be had
+    the audio thread run it itself, and the output doesn't depend on which
+    thread did.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+class PipelineWorker
+{
+public:
+    using Job = void (*)(void* context);
+
+    /* how long collect() spins on a job the worker is partway through before
+       it blocks instead */
+    static constexpr std::chrono::microseconds spinLimit {100};
+
+    /* starts the thread */
+    PipelineWorker();
+    ~PipelineWorker();
+
+    /* audio thread: hands job over; the last one must have been collected */
+    void post(Job job, void* context);
+
+    /* audio thread: returns once the last job posted has run, here if the
+       worker hadn't started it; does nothing if none is outstanding */
+    void collect();
+
+    /* jobs the audio thread ran itself or had to wait for, since construction */
+    int getNumLate() const { return numLate.load(std::memory_order_relaxed); }
+
+    /* of those, the ones it waited on for longer than spinLimit */
+    int getNumStalled() const { return numStalled.load(std::memory_order_relaxed); }
+
+private:
+    enum State { idle, posted, claimed, finished };
+
+    std::atomic<int> state {idle};
+    Job job {nullptr};
+    void* context {nullptr};
+    std::uint64_t floatMode {0};
+    std::atomic<int> numLate {0}, numStalled {0};
+
+    std::mutex wakeLock;
+    std::condition_variable wake, done;
+    std::atomic<bool> alive {true};
+    std::thread thread;
+
+    void run();
+
+    PipelineWorker(const PipelineWorker&) = delete;
+    PipelineWorker& operator=(const PipelineWorker&) = delete;
+};
@@ -0,0 +1,104 @@
+/*
+  ==============================================================================
+
+    StageProfiler.cpp
+
+  ==============================================================================
+*/
+
+#include "StageProfiler.h"
+
+#include <chrono>
+
+//==============================================================================
+const char* StageProfiler::getStageName(Stage stage)
+{
+    switch (stage) {
+        case Stage::firTaps: return "fir taps";
+        case Stage::combs:   return "combs";
+        case Stage::allpass: return "allpass";
+        case Stage::mix:     return "mix";
+    }
+    return "unknown";
+}
+
+StageProfiler::StageProfiler(int capacity)
+{
+    size_t size = 1;
+    while (size < (size_t)capacity)
+        size <<= 1;
+
+    events.resize(size);
+    mask = size - 1;
+}
+
+int64_t StageProfiler::now() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void StageProfiler::record(Stage stage, int track, int64_t begin, int64_t end) noexcept
+{
+    const uint64_t write = writeIndex.load(std::memory_order_relaxed);
+    if (write - readIndex.load(std::memory_order_acquire) > mask) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto& event = events[(size_t)(write & mask)];
+    event.begin = begin;
+    event.end = end;
+    event.stage = stage;
+    event.track = (uint8_t)track;
+
+    writeIndex.store(write + 1, std::memory_order_release);
+}
+
+//==============================================================================
+ChromeTraceWriter::ChromeTraceWriter(StageProfiler& profilerToDrain, const std::string& path)
+    : profiler(profilerToDrain), file(std::fopen(path.c_str(), "w")), origin(StageProfiler::now())
+{
+    if (file == nullptr)
+        return;
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    thread = std::thread([this] { run(); });
+}
+
+ChromeTraceWriter::~ChromeTraceWriter()
+{
+    running = false;
+    if (thread.joinable())
+        thread.join();
+
+    if (file != nullptr) {
+        // events lost to a full ring, as a counter at the end of the trace
+        std::fprintf(file, "%s{\"name\":\"dropped events\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{\"count\":%llu}}\n]}\n",
+                     firstEvent ? "" : ",\n", (double)(StageProfiler::now() - origin)*1.0e-3,
+                     (unsigned long long)profiler.getNumDropped());
+        std::fclose(file);
+    }
+}
+
+void ChromeTraceWriter::run()
+{
+    while (running) {
+        writeEvents();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    // whatever the audio thread managed to push before we were stopped
+    writeEvents();
+}
+
+void ChromeTraceWriter::writeEvents()
+{
+    profiler.drain([this](const StageProfiler::Event& event) {
+        // complete ("X") events, timestamps in microseconds from when the writer started
+        std::fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"dsp\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                     firstEvent ? "" : ",\n", StageProfiler::getStageName(event.stage),
+                     (double)(event.begin - origin)*1.0e-3, (double)(event.end - event.begin)*1.0e-3, (int)event.track + 1);
+        firstEvent = false;
+    });
+    std::fflush(file);
+}
@@ -0,0 +1,123 @@
+/*
+  ==============================================================================
+
+    StageProfiler.h
+
+    Optional timing probes around the stages of the reverb. The audio thread
+    records one begin/end pair per stage and chunk into a preallocated
+    single-producer ring; recording never blocks or allocates, and events are
+    dropped (and counted) if the ring is full. A ChromeTraceWriter drains the
+    ring on its own thread into a Chrome trace / Perfetto JSON file.
+
+    Build with MOORER_STAGE_PROFILER=0 to compile the probes out entirely.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#ifndef MOORER_STAGE_PROFILER
+ #define MOORER_STAGE_PROFILER 1
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+class StageProfiler
+{
+public:
+    enum class Stage : uint8_t { firTaps, combs, allpass, mix };
+
+    static const char* getStageName(Stage stage);
+
+    struct Event
+    {
+        int64_t begin {0}, end {0};     // nanoseconds on the steady clock
+        Stage stage {Stage::firTaps};
+        uint8_t track {0};              // channel, or 0 for an interleaved pair
+    };
+
+    /* capacity is rounded up to a power of two */
+    explicit StageProfiler(int capacity = 1 << 16);
+
+    static int64_t now() noexcept;
+
+    /* audio thread only */
+    void record(Stage stage, int track, int64_t begin, int64_t end) noexcept;
+
+    /* reader thread only: hands every pending event to f and returns the count */
+    template <typename Function>
+    int drain(Function&& f)
+    {
+        const uint64_t end = writeIndex.load(std::memory_order_acquire);
+        uint64_t read = readIndex.load(std::memory_order_relaxed);
+        const int count = (int)(end - read);
+
+        for (; read != end; ++read)
+            f(events[(size_t)(read & mask)]);
+
+        readIndex.store(read, std::memory_order_release);
+        return count;
+    }
+
+    uint64_t getNumDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+    /* times the enclosing scope; does nothing without a profiler */
+    class Scope
+    {
+    public:
+        Scope(StageProfiler* profilerToUse, Stage stageToTime, int trackToUse) noexcept
+            : profiler(profilerToUse), stage(stageToTime), track(trackToUse),
+              begin(profilerToUse != nullptr ? now() : 0) {}
+
+        ~Scope()
+        {
+            if (profiler != nullptr)
+                profiler->record(stage, track, begin, now());
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        StageProfiler* profiler;
+        Stage stage;
+        int track;
+        int64_t begin;
+    };
+
+private:
+    std::vector<Event> events;
+    uint64_t mask {0};
+    std::atomic<uint64_t> writeIndex {0}, readIndex {0}, dropped {0};
+};
+
+//==============================================================================
+/* drains a StageProfiler into a trace file every few milliseconds until
+   destroyed; open the file in chrome://tracing or ui.perfetto.dev */
+class ChromeTraceWriter
+{
+public:
+    ChromeTraceWriter(StageProfiler& profilerToDrain, const std::string& path);
+    ~ChromeTraceWriter();
+
+    bool isOpen() const { return file != nullptr; }
+
+private:
+    StageProfiler& profiler;
+    std::FILE* file {nullptr};
+    std::atomic<bool> running {true};
+    std::thread thread;
+    int64_t origin {0};
+    bool firstEvent {true};
+
+    void run();
+    void writeEvents();
+
+    ChromeTraceWriter(const ChromeTraceWriter&) = delete;
+    ChromeTraceWriter& operator=(const ChromeTraceWriter&) = delete;
+};
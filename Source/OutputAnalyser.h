@@ -0,0 +1,214 @@
+/*
+  ==============================================================================
+
+    OutputAnalyser.h
+
+    Feeds the editor's view of the wet output's decay and spectrum. The audio
+    thread mixes each block to mono, decimates it to 48 kHz or below and
+    pushes it into a wait-free FIFO, dropping the block whole if there's no
+    room (as there isn't while no editor is reading). The message thread
+    drains it into the last fftSize samples and a trace of the energy every
+    decayStepSeconds, and runs the FFT only when it's asked for a spectrum.
+
+    Build with MOORER_OUTPUT_ANALYSER=0 to compile the analyser out entirely.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#ifndef MOORER_OUTPUT_ANALYSER
+ #define MOORER_OUTPUT_ANALYSER 1
+#endif
+
+#if MOORER_OUTPUT_ANALYSER
+
+#include <JuceHeader.h>
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <complex>
+
+class OutputAnalyser
+{
+public:
+    static constexpr int fftOrder = 11;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int numBands = 48;
+    static constexpr float minimumFrequency = 30.0f;
+    static constexpr int decayLength = 240;
+    static constexpr double decayStepSeconds = 0.0125;   // 3 s across the trace
+    static constexpr float floorDecibels = -90.0f;
+
+    OutputAnalyser()
+    {
+        for (int i = 0; i < fftSize; ++i)
+            window[(size_t)i] = 0.5f - 0.5f*std::cos(juce::MathConstants<float>::twoPi*(float)i/(float)fftSize);
+        for (int k = 0; k < fftSize/2; ++k)
+            twiddles[(size_t)k] = std::polar(1.0f, -juce::MathConstants<float>::twoPi*(float)k/(float)fftSize);
+        spectrum.fill(floorDecibels);
+        decay.fill(floorDecibels);
+    }
+
+    /* call while the audio thread is stopped, i.e. from prepareToPlay() */
+    void prepare(double sampleRate)
+    {
+        decimation = juce::jmax(1, juce::roundToInt(sampleRate/48000.0));
+        pending = 0.0f;
+        pendingCount = 0;
+        analysisRate.store(sampleRate/(double)decimation);
+    }
+
+    /* audio thread: never blocks, and costs a mono mix and a copy */
+    template <typename SampleType>
+    void push(const SampleType* const* channels, int numChannels, int numSamples)
+    {
+        if (numChannels <= 0 || numSamples <= 0)
+            return;
+
+        const int toWrite = (pendingCount + numSamples)/decimation;
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(toWrite, start1, size1, start2, size2);
+        if (size1 + size2 < toWrite) {
+            pendingCount = 0;
+            pending = 0.0f;
+            return;
+        }
+
+        const float scale = 1.0f/(float)(numChannels*decimation);
+        int written = 0;
+        for (int k = 0; k < numSamples; ++k) {
+            for (int channel = 0; channel < numChannels; ++channel)
+                pending += (float)channels[channel][k];
+
+            if (++pendingCount == decimation) {
+                samples[(size_t)(written < size1 ? start1 + written : start2 + written - size1)] = pending*scale;
+                ++written;
+                pending = 0.0f;
+                pendingCount = 0;
+            }
+        }
+        fifo.finishedWrite(written);
+    }
+
+    /* message thread only: takes in whatever the audio thread has pushed
+       since the last call; false if there was nothing */
+    bool update()
+    {
+        const int ready = fifo.getNumReady();
+        if (ready == 0)
+            return false;
+
+        const int decayStep = juce::jmax(1, juce::roundToInt(decayStepSeconds*analysisRate.load()));
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(ready, start1, size1, start2, size2);
+        auto take = [&](int start, int size) {
+            for (int i = start; i < start + size; ++i) {
+                const float sample = samples[(size_t)i];
+                history[(size_t)historyWrite] = sample;
+                historyWrite = (historyWrite + 1) & (fftSize - 1);
+
+                energy += sample*sample;
+                if (++energyCount >= decayStep) {
+                    decay[(size_t)decayWrite] = toDecibels(energy/(float)energyCount);
+                    decayWrite = (decayWrite + 1) % decayLength;
+                    energy = 0.0f;
+                    energyCount = 0;
+                }
+            }
+        };
+        take(start1, size1);
+        take(start2, size2);
+        fifo.finishedRead(size1 + size2);
+        return true;
+    }
+
+    /* message thread only: the level in dB of each of numBands log-spaced
+       bands from minimumFrequency up, over the latest fftSize samples; bands
+       fall back slowly rather than jumping, so the display doesn't flicker */
+    const std::array<float, numBands>& getSpectrum()
+    {
+        for (int i = 0; i < fftSize; ++i)
+            bins[(size_t)i] = history[(size_t)((historyWrite + i) & (fftSize - 1))]*window[(size_t)i];
+        transform();
+
+        // a full-scale sine through the Hann window peaks at fftSize/4
+        const float reference = toDecibels((float)(fftSize/4)*(float)(fftSize/4));
+        const float nyquist = 0.5f*(float)analysisRate.load();
+        const float binsPerHz = (float)fftSize/(2.0f*nyquist);
+        for (int band = 0; band < numBands; ++band) {
+            const int low = juce::jlimit(1, fftSize/2 - 1, (int)(bandEdge(band, nyquist)*binsPerHz));
+            const int high = juce::jlimit(low + 1, fftSize/2, (int)(bandEdge(band + 1, nyquist)*binsPerHz));
+            float power = 0.0f;
+            for (int bin = low; bin < high; ++bin)
+                power = juce::jmax(power, std::norm(bins[(size_t)bin]));
+
+            const float level = juce::jmax(floorDecibels, toDecibels(power) - reference);
+            spectrum[(size_t)band] = juce::jmax(level, spectrum[(size_t)band] - 3.0f);
+        }
+        return spectrum;
+    }
+
+    /* message thread only: the energy in dB every decayStepSeconds, oldest first */
+    float getDecay(int index) const { return decay[(size_t)((decayWrite + index) % decayLength)]; }
+
+    /* the lower edge of a band in Hz; band numBands is the Nyquist frequency */
+    static float bandEdge(int band, float nyquist)
+    {
+        return minimumFrequency*std::pow(nyquist/minimumFrequency, (float)band/(float)numBands);
+    }
+
+    double getAnalysisRate() const { return analysisRate.load(); }
+
+private:
+    static constexpr int fifoSize = 8192;
+
+    static float toDecibels(float power) { return 10.0f*std::log10(power + 1.0e-12f); }
+
+    // audio thread only
+    int decimation {1};
+    float pending {0.0f};
+    int pendingCount {0};
+
+    // audio thread -> message thread; blocks are dropped while nobody is reading
+    juce::AbstractFifo fifo {fifoSize};
+    std::array<float, fifoSize> samples {};
+    std::atomic<double> analysisRate {44100.0};
+
+    // message thread only
+    std::array<float, fftSize> history {}, window;
+    std::array<std::complex<float>, fftSize> bins;
+    std::array<std::complex<float>, fftSize/2> twiddles;
+    std::array<float, numBands> spectrum;
+    std::array<float, decayLength> decay;
+    int historyWrite {0}, decayWrite {0}, energyCount {0};
+    float energy {0.0f};
+
+    /* in-place radix-2 FFT of bins; the plugin doesn't pull in juce_dsp for one transform */
+    void transform()
+    {
+        for (int i = 1, j = 0; i < fftSize; ++i) {
+            int bit = fftSize >> 1;
+            for (; j & bit; bit >>= 1)
+                j ^= bit;
+            j ^= bit;
+            if (i < j)
+                std::swap(bins[(size_t)i], bins[(size_t)j]);
+        }
+
+        for (int length = 2; length <= fftSize; length <<= 1) {
+            const int stride = fftSize/length, half = length/2;
+            for (int i = 0; i < fftSize; i += length) {
+                for (int k = 0; k < half; ++k) {
+                    const auto u = bins[(size_t)(i + k)];
+                    const auto v = bins[(size_t)(i + k + half)]*twiddles[(size_t)(k*stride)];
+                    bins[(size_t)(i + k)] = u + v;
+                    bins[(size_t)(i + k + half)] = u - v;
+                }
+            }
+        }
+    }
+};
+
+#endif
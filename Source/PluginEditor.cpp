@@ -13,79 +13,45 @@ using namespace juce;
 
 //==============================================================================
 MoorerReverbAudioProcessorEditor::MoorerReverbAudioProcessorEditor (MoorerReverbAudioProcessor& p)
-    : AudioProcessorEditor (&p), audioProcessor (p)
+    : AudioProcessorEditor (&p), audioProcessor (p),
+      timeKnob (p.getParameterByID("reverbtime"), 0, 4),         // 0.5-1
+      predelay1Knob (p.getParameterByID("predelay1"), 0.5, 100),  // 0.0005-0.1 s
+      dampingKnob (p.getParameterByID("damping"), 0, 100),        // 0-1.8
+      wetKnob (p.getParameterByID("wetmix"), 0, 100)              // 0-1
+   #if MOORER_CPU_LOAD_METER
+    , cpuLoadDisplay (p)
+   #endif
+   #if MOORER_OUTPUT_ANALYSER
+    , outputDisplay (p)
+   #endif
 {
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
-    setSize (360, 300);
+    setSize (360, 400);
     
     
     /* reverb time (RT60) */
-    addAndMakeVisible(timeSlider);
-    timeSlider.setSliderStyle(Slider::SliderStyle::RotaryVerticalDrag);
-    timeSlider.setTextBoxStyle(Slider::TextEntryBoxPosition::TextBoxBelow, true, 60, 20);
-    timeSlider.setColour(Slider::textBoxTextColourId, Colours::black);
-    timeSlider.setTextBoxIsEditable(true);
-    timeSlider.setRange(0.2, 4, 0.02);
-    timeSlider.setValue(3);
-    timeSlider.setTextValueSuffix(" s");
-    timeSlider.addListener(this);
-    // label
-    addAndMakeVisible(timeLabel);
-    timeLabel.setText("reverb time", juce::dontSendNotification);
-    timeLabel.setJustificationType(juce::Justification::centred);
-    timeLabel.attachToComponent(&timeSlider, false);
-        
+    setUpKnob(timeKnob, "reverb time", 0.02, " s");
     
     /* pre delay 1 (early refl.) */
-    addAndMakeVisible(predelay1Slider);
-    predelay1Slider.setSliderStyle(Slider::SliderStyle::RotaryVerticalDrag);
-    predelay1Slider.setTextBoxStyle(Slider::TextEntryBoxPosition::TextBoxBelow, true, 60, 20);
-    predelay1Slider.setColour(Slider::textBoxTextColourId, Colours::black);
-    predelay1Slider.setTextBoxIsEditable(true);
-    predelay1Slider.setRange(0.5, 100, 0.5);
-    predelay1Slider.setValue(20);
-    predelay1Slider.setTextValueSuffix(" ms");
-    predelay1Slider.addListener(this);
-    // label
-    addAndMakeVisible(predelay1Label);
-    predelay1Label.setText("predelay 1", juce::dontSendNotification);
-    predelay1Label.setJustificationType(juce::Justification::centred);
-    predelay1Label.attachToComponent(&predelay1Slider, false);
-    
+    setUpKnob(predelay1Knob, "predelay 1", 0.5, " ms");
     
     /* damping */
-    addAndMakeVisible(dampingSlider);
-    dampingSlider.setSliderStyle(Slider::SliderStyle::RotaryVerticalDrag);
-    dampingSlider.setTextBoxStyle(Slider::TextEntryBoxPosition::TextBoxBelow, true, 60, 20);
-    dampingSlider.setColour(Slider::textBoxTextColourId, Colours::black);
-    dampingSlider.setTextBoxIsEditable(true);
-    dampingSlider.setRange(0, 100, 1);
-    dampingSlider.setValue(20);
-    dampingSlider.setTextValueSuffix(" %");
-    dampingSlider.addListener(this);
-    // label
-    addAndMakeVisible(dampingLabel);
-    dampingLabel.setText("damping", juce::dontSendNotification);
-    dampingLabel.setJustificationType(juce::Justification::centred);
-    dampingLabel.attachToComponent(&dampingSlider, false);
-    
+    setUpKnob(dampingKnob, "damping", 1, " %");
     
     /* wet/dry mix */
-    addAndMakeVisible(wetSlider);
-    wetSlider.setSliderStyle(Slider::SliderStyle::RotaryVerticalDrag);
-    wetSlider.setTextBoxStyle(Slider::TextEntryBoxPosition::TextBoxBelow, true, 60, 20);
-    wetSlider.setColour(Slider::textBoxTextColourId, Colours::black);
-    wetSlider.setTextBoxIsEditable(true);
-    wetSlider.setRange(0, 100, 1);
-    wetSlider.setValue(100);
-    wetSlider.setTextValueSuffix(" %");
-    wetSlider.addListener(this);
-    // label
-    addAndMakeVisible(wetLabel);
-    wetLabel.setText("wet/dry", juce::dontSendNotification);
-    wetLabel.setJustificationType(juce::Justification::centred);
-    wetLabel.attachToComponent(&wetSlider, false);
+    setUpKnob(wetKnob, "wet/dry", 1, " %");
+    
+    // fast enough to follow automation smoothly, however densely the host sends it
+    startTimerHz(30);
+    
+    
+   #if MOORER_CPU_LOAD_METER
+    addAndMakeVisible(cpuLoadDisplay);
+   #endif
+   #if MOORER_OUTPUT_ANALYSER
+    addAndMakeVisible(outputDisplay);
+   #endif
     
     
     getLookAndFeel().setColour(Label::textColourId, Colours::black);
@@ -108,26 +74,180 @@ void MoorerReverbAudioProcessorEditor::paint (juce::Graphics& g)
 
 void MoorerReverbAudioProcessorEditor::resized()
 {
-    timeSlider.setBounds(getWidth()/2-100, getHeight()/2-100, 80, 80);
-    dampingSlider.setBounds(getWidth()/2+20, getHeight()/2-100, 80, 80);
-    predelay1Slider.setBounds(getWidth()/2-100, getHeight()/2+20, 80, 80);
-    wetSlider.setBounds(getWidth()/2+20, getHeight()/2+20, 80, 80);
+    // the knobs keep the top 300 pixels, the display has the rest
+    const int knobsCentreY = 150;
+    timeKnob.slider.setBounds(getWidth()/2-100, knobsCentreY-100, 80, 80);
+    dampingKnob.slider.setBounds(getWidth()/2+20, knobsCentreY-100, 80, 80);
+    predelay1Knob.slider.setBounds(getWidth()/2-100, knobsCentreY+20, 80, 80);
+    wetKnob.slider.setBounds(getWidth()/2+20, knobsCentreY+20, 80, 80);
+
+   #if MOORER_OUTPUT_ANALYSER
+    outputDisplay.setBounds(10, 2*knobsCentreY, getWidth()-20, getHeight()-2*knobsCentreY-30);
+   #endif
+
+   #if MOORER_CPU_LOAD_METER
+    cpuLoadDisplay.setBounds(10, getHeight()-24, getWidth()-20, 14);
+   #endif
+}
+
+void MoorerReverbAudioProcessorEditor::setUpKnob(ParameterKnob& knob, const String& name, double interval, const String& suffix)
+{
+    auto& slider = knob.slider;
+    addAndMakeVisible(slider);
+    slider.setSliderStyle(Slider::SliderStyle::RotaryVerticalDrag);
+    slider.setTextBoxStyle(Slider::TextEntryBoxPosition::TextBoxBelow, true, 60, 20);
+    slider.setColour(Slider::textBoxTextColourId, Colours::black);
+    slider.setTextBoxIsEditable(true);
+    slider.setRange(knob.minimum, knob.maximum, interval);
+    slider.setValue(knob.toKnob(knob.parameter.getValue()), dontSendNotification);
+    slider.setDoubleClickReturnValue(true, knob.toKnob(knob.parameter.getDefaultValue()));
+    slider.setTextValueSuffix(suffix);
+    slider.addListener(this);
+    // label
+    addAndMakeVisible(knob.label);
+    knob.label.setText(name, juce::dontSendNotification);
+    knob.label.setJustificationType(juce::Justification::centred);
+    knob.label.attachToComponent(&slider, false);
+}
+
+ParameterKnob* MoorerReverbAudioProcessorEditor::knobFor(Slider* slider)
+{
+    for (auto* knob : { &timeKnob, &predelay1Knob, &dampingKnob, &wetKnob })
+        if (slider == &knob->slider)
+            return knob;
+    return nullptr;
 }
 
 void MoorerReverbAudioProcessorEditor::sliderValueChanged(Slider* slider)
 {
-    auto& audioParams = audioProcessor.getParameters();
-    if (slider == &timeSlider) {
-        AudioParameterFloat* timeParam = (AudioParameterFloat*) audioParams.getUnchecked(0);
-        *timeParam = (float)timeSlider.getValue()/8.0f + 0.5; // scale 0-4 to 0.5-1
-    } else if (slider == &predelay1Slider) {
-        AudioParameterFloat* predelay1Param = (AudioParameterFloat*) audioParams.getUnchecked(1);
-        *predelay1Param = predelay1Slider.getValue()/1000.0f;
-    } else if (slider == &dampingSlider) {
-        AudioParameterFloat* dampingParam = (AudioParameterFloat*) audioParams.getUnchecked(2);
-        *dampingParam = (dampingSlider.getValue()/100.0f) + 0.5f; // scale 0-100 to 0.5-1.5
-    } else if (slider == &wetSlider) {
-        AudioParameterFloat* wetParam = (AudioParameterFloat*) audioParams.getUnchecked(3);
-        *wetParam = wetSlider.getValue()/100.0f;
+    auto* knob = knobFor(slider);
+    if (knob == nullptr)
+        return;
+
+    // a drag is one gesture; a typed value or a double-click is one on its own
+    if (! knob->dragging)
+        knob->parameter.beginChangeGesture();
+    knob->parameter.setValueNotifyingHost(knob->toNormalised(slider->getValue()));
+    if (! knob->dragging)
+        knob->parameter.endChangeGesture();
+}
+
+void MoorerReverbAudioProcessorEditor::sliderDragStarted(Slider* slider)
+{
+    if (auto* knob = knobFor(slider)) {
+        knob->dragging = true;
+        knob->parameter.beginChangeGesture();
+    }
+}
+
+void MoorerReverbAudioProcessorEditor::sliderDragEnded(Slider* slider)
+{
+    if (auto* knob = knobFor(slider)) {
+        knob->dragging = false;
+        knob->parameter.endChangeGesture();
+    }
+}
+
+void MoorerReverbAudioProcessorEditor::timerCallback()
+{
+    // a knob being dragged is the source of its value, so it's left alone
+    for (auto* knob : { &timeKnob, &predelay1Knob, &dampingKnob, &wetKnob })
+        if (! knob->dragging)
+            knob->slider.setValue(knob->toKnob(knob->parameter.getValue()), dontSendNotification);
+}
+
+#if MOORER_CPU_LOAD_METER
+//==============================================================================
+CpuLoadDisplay::CpuLoadDisplay (MoorerReverbAudioProcessor& p)
+    : audioProcessor (p)
+{
+    startTimerHz(4);
+}
+
+void CpuLoadDisplay::timerCallback()
+{
+    stats = audioProcessor.getCpuLoadStats();
+    repaint();
+}
+
+void CpuLoadDisplay::paint (juce::Graphics& g)
+{
+    auto bounds = getLocalBounds();
+    auto bar = bounds.removeFromLeft(60).reduced(0, 3);
+
+    g.setColour(Colours::lightgrey);
+    g.fillRect(bar);
+    g.setColour(stats.p99Load < 0.5f ? Colours::orange : Colours::orangered);
+    g.fillRect(bar.withWidth(roundToInt(jlimit(0.0f, 1.0f, stats.meanLoad)*(float)bar.getWidth())));
+    g.setColour(Colours::black);
+    g.drawVerticalLine(bar.getX() + roundToInt(jlimit(0.0f, 1.0f, stats.p99Load)*(float)(bar.getWidth() - 1)),
+                       (float)bar.getY(), (float)bar.getBottom());
+
+    // shares of the block deadline over the last few hundred blocks
+    g.setFont(11.0f);
+    g.drawText("cpu " + String(100.0f*stats.meanLoad, 1) + "%  p99 " + String(100.0f*stats.p99Load, 1)
+                   + "%  max " + String(100.0f*stats.maxLoad, 1) + "%",
+               bounds.withTrimmedLeft(6), Justification::centredLeft);
+}
+#endif
+
+#if MOORER_OUTPUT_ANALYSER
+//==============================================================================
+OutputDisplay::OutputDisplay (MoorerReverbAudioProcessor& p)
+    : analyser (p.getOutputAnalyser())
+{
+    spectrum.fill(OutputAnalyser::floorDecibels);
+
+    // opaque, so repainting it never repaints the editor behind it
+    setOpaque(true);
+    startTimerHz(30);
+}
+
+void OutputDisplay::timerCallback()
+{
+    if (! analyser.update())
+        return;
+
+    spectrum = analyser.getSpectrum();
+    repaint();
+}
+
+float OutputDisplay::toY (float decibels, juce::Rectangle<float> area) const
+{
+    const float proportion = jlimit(0.0f, 1.0f, decibels/OutputAnalyser::floorDecibels);
+    return area.getY() + proportion*area.getHeight();
+}
+
+void OutputDisplay::paint (juce::Graphics& g)
+{
+    g.fillAll(Colours::white);
+
+    auto bounds = getLocalBounds().toFloat().reduced(4.0f);
+    const auto spectrumArea = bounds.removeFromLeft(bounds.getWidth()/2).reduced(2.0f, 0.0f);
+    const auto decayArea = bounds.reduced(2.0f, 0.0f);
+
+    g.setColour(Colours::orange);
+    const float bandWidth = spectrumArea.getWidth()/(float)OutputAnalyser::numBands;
+    for (int band = 0; band < OutputAnalyser::numBands; ++band) {
+        const float top = toY(spectrum[(size_t)band], spectrumArea);
+        g.fillRect(Rectangle<float>(spectrumArea.getX() + (float)band*bandWidth, top,
+                                    jmax(1.0f, bandWidth - 1.0f), spectrumArea.getBottom() - top));
     }
+
+    Path decay;
+    const float step = decayArea.getWidth()/(float)(OutputAnalyser::decayLength - 1);
+    for (int i = 0; i < OutputAnalyser::decayLength; ++i) {
+        const float x = decayArea.getX() + (float)i*step, y = toY(analyser.getDecay(i), decayArea);
+        if (i == 0)
+            decay.startNewSubPath(x, y);
+        else
+            decay.lineTo(x, y);
+    }
+    g.setColour(Colours::black);
+    g.strokePath(decay, PathStrokeType(1.0f));
+
+    g.setFont(11.0f);
+    g.drawText("spectrum", spectrumArea.toNearestInt(), Justification::topLeft);
+    g.drawText("decay", decayArea.toNearestInt(), Justification::topLeft);
 }
+#endif
@@ -13,11 +13,73 @@
 
 using namespace juce;
 
+#if MOORER_CPU_LOAD_METER
+//==============================================================================
+/* a small bar showing the mean share of the block deadline in use, with the
+   99th percentile marked and the numbers written alongside */
+class CpuLoadDisplay  : public juce::Component,
+                        private juce::Timer
+{
+public:
+    CpuLoadDisplay (MoorerReverbAudioProcessor&);
+
+    void paint (juce::Graphics&) override;
+
+private:
+    MoorerReverbAudioProcessor& audioProcessor;
+    CpuLoadMeter::Stats stats;
+
+    void timerCallback() override;
+};
+#endif
+
+#if MOORER_OUTPUT_ANALYSER
+//==============================================================================
+/* the output's spectrum on the left and its energy over the last few
+   seconds on the right; it only repaints itself, and only when the audio
+   thread has pushed something new */
+class OutputDisplay  : public juce::Component,
+                       private juce::Timer
+{
+public:
+    OutputDisplay (MoorerReverbAudioProcessor&);
+
+    void paint (juce::Graphics&) override;
+
+private:
+    OutputAnalyser& analyser;
+    std::array<float, OutputAnalyser::numBands> spectrum;
+
+    void timerCallback() override;
+    float toY (float decibels, juce::Rectangle<float> area) const;
+};
+#endif
+
+//==============================================================================
+/* a knob for one parameter, in the units it's shown in. The knob's ends are
+   the parameter's ends and it is linear in between, which is the only mapping
+   between the two; the parameters' own ranges are linear too */
+struct ParameterKnob
+{
+    ParameterKnob (juce::RangedAudioParameter& p, double minimumToShow, double maximumToShow)
+        : parameter (p), minimum (minimumToShow), maximum (maximumToShow) {}
+
+    juce::RangedAudioParameter& parameter;
+    Slider slider;
+    Label label;
+    double minimum, maximum;
+    bool dragging {false};
+
+    double toKnob (float normalised) const       { return minimum + (maximum - minimum)*normalised; }
+    float toNormalised (double knobValue) const  { return (float)jlimit(0.0, 1.0, (knobValue - minimum)/(maximum - minimum)); }
+};
+
 //==============================================================================
 /**
 */
 class MoorerReverbAudioProcessorEditor  : public juce::AudioProcessorEditor,
-                                             public juce::Slider::Listener
+                                             public juce::Slider::Listener,
+                                             private juce::Timer
 {
 public:
     MoorerReverbAudioProcessorEditor (MoorerReverbAudioProcessor&);
@@ -27,23 +89,33 @@ public:
     void paint (juce::Graphics&) override;
     void resized() override;
     void sliderValueChanged(Slider*) override;
+    void sliderDragStarted(Slider*) override;
+    void sliderDragEnded(Slider*) override;
 
 private:
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     MoorerReverbAudioProcessor& audioProcessor;
     
-    Slider timeSlider;
-    Label timeLabel;
-    
-    Slider predelay1Slider;
-    Label predelay1Label;
-    
-    Slider dampingSlider;
-    Label dampingLabel;
-    
-    Slider wetSlider;
-    Label wetLabel;
+    ParameterKnob timeKnob;
+    ParameterKnob predelay1Knob;
+    ParameterKnob dampingKnob;
+    ParameterKnob wetKnob;
+
+    ParameterKnob* knobFor (Slider*);
+    void setUpKnob (ParameterKnob&, const String& name, double interval, const String& suffix);
+
+    /* the knobs follow the parameters by polling them, so automation and
+       recalled state show up without a message per change */
+    void timerCallback() override;
+
+   #if MOORER_CPU_LOAD_METER
+    CpuLoadDisplay cpuLoadDisplay;
+   #endif
+
+   #if MOORER_OUTPUT_ANALYSER
+    OutputDisplay outputDisplay;
+   #endif
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MoorerReverbAudioProcessorEditor)
 };
@@ -11,6 +11,30 @@
 
 using namespace juce;
 
+namespace
+{
+    /* the factory programs; eco and topology are parameter indices */
+    struct Program
+    {
+        const char* name;
+        float reverbTime, predelay, damping, wetMix;
+        int eco, topology;
+    };
+
+    const Program programs[] = {
+        { "Default",           0.875f, 0.02f,   0.7f, 1.0f,  0, 0 },
+        { "Small Room",        0.6f,   0.005f,  1.2f, 0.35f, 0, 0 },
+        { "Dark Chamber",      0.85f,  0.015f,  1.6f, 0.45f, 0, 0 },
+        { "Hall",              0.93f,  0.035f,  0.5f, 0.4f,  0, 2 },
+        { "Long Tail",         0.98f,  0.06f,   0.3f, 0.5f,  0, 2 },
+        { "Vintage Schroeder", 0.8f,   0.01f,   0.6f, 0.4f,  0, 1 },
+        { "Eco Hall",          0.93f,  0.035f,  0.5f, 0.4f,  2, 0 },
+    };
+
+    // the tag the state is saved under
+    const char* const stateTag = "MOORERREVERB";
+}
+
 //==============================================================================
 MoorerReverbAudioProcessor::MoorerReverbAudioProcessor()
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -21,13 +45,8 @@ MoorerReverbAudioProcessor::MoorerReverbAudioProcessor()
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
-                       ),
+                       )
 #endif
-    inputDelayBuffer(2,1),
-    firDelayBuffer(2,1),
-    combDelayBuffers(12,1),
-    combDelayBuffer(2,1),
-    allpassDelayBuffers(2,1)
 {
     addParameter(reverbTime = new AudioParameterFloat("reverbtime", "Reverb Time", 
                                                       NormalisableRange<float>(0.5f, 1.f), 0.875f));
@@ -35,31 +54,32 @@ MoorerReverbAudioProcessor::MoorerReverbAudioProcessor()
                                                      NormalisableRange<float>(0.0005f, 0.1f), 0.02f));
     addParameter(damping = new AudioParameterFloat("damping", "Damping", 0.0f, 1.8f, 0.7f));
     addParameter(wetMix = new AudioParameterFloat("wetmix", "Wet Mix", 0.0f, 1.0f, 1.0f));
+    addParameter(eco = new AudioParameterChoice("eco", "Eco", StringArray { "Off", "2x", "4x" }, 0));
+    // in TopologyPreset order
+    addParameter(topology = new AudioParameterChoice("topology", "Topology", StringArray { "Moorer", "Schroeder", "Dense" }, 0));
+    // runs the combs and allpasses on a second core; it adds no latency, so there's nothing to report
+    addParameter(multicore = new AudioParameterBool("multicore", "Multicore", false));
     
-    
-    /* these delay times and gains are recommended for the 7-tap reverb in
-       [1] J. A. Moorer, "About This Reverberation Business," Computer Music Journal,
-           vol. 3, no. 2, pp. 13-28 (1979 Jun.). https://doi.org/10.2307/3680280.
-     */
-    
-    // 0.0199, 0.0354, 0.0389, 0.0414, 0.0699, 0.0796 w/ compensation for predelay
-    const float firLengths[6] = { 0.0f, 0.0155f, 0.019f,
-                                  0.0215f, 0.05f, 0.0597f };
-    memcpy(firDelayLengths, firLengths, sizeof(firLengths));
-    const float firGains[6] = { 0.921f,  0.818f, 0.635f,
-                                0.719f, 0.267f, 0.242f };
-    memcpy(firCoefficients, firGains, sizeof(firGains));
-    
-    
-    // Moorer, 1965: 0.03, 0.034, 0.037, 0.041
-    const float iirLengths[6] = { 0.05f,  0.056f, 0.061f,
-                                  0.068f, 0.072f, 0.078f };
-    memcpy(iirDelayLengths, iirLengths, sizeof(iirLengths));
-    // damping is 0-1.8 to map these values to 0-0.99
-    const float iirGains[6] = { 0.46f, 0.48f, 0.5f, 0.52f, 0.53f, 0.55f };
-    memcpy(iirCoefficients, iirGains, sizeof(iirGains));
-    
-    delayWrite = 0;
+    // the per-comb loops are vectorised by the dispatched kernels, and beat the bank's per-frame steps
+    engine.setCombEngine(MoorerReverbEngine::CombEngine::scalar);
+    doubleEngine.setCombEngine(MoorerReverbEngine::CombEngine::scalar);
+
+    // once, so hosts that re-prepare on every rate or layout change reuse it
+    // (engines built later are reserved for the same limits as they're built)
+    engine.reserve(getConfiguration<float>(), MOORER_MAX_SAMPLE_RATE, 2);
+
+   #if MOORER_STAGE_PROFILER
+    // each instance writes its own trace next to the requested path
+    if (const char* tracePath = std::getenv("MOORER_TRACE_FILE")) {
+        stageProfiler = std::make_unique<StageProfiler>();
+        traceWriter = std::make_unique<ChromeTraceWriter>(*stageProfiler,
+                          File(tracePath).getNonexistentSibling().getFullPathName().toStdString());
+        if (traceWriter->isOpen()) {
+            engine.setProfiler(stageProfiler.get());
+            doubleEngine.setProfiler(stageProfiler.get());
+        }
+    }
+   #endif
 }
 
 MoorerReverbAudioProcessor::~MoorerReverbAudioProcessor()
@@ -101,27 +121,48 @@ bool MoorerReverbAudioProcessor::isMidiEffect() const
 
 double MoorerReverbAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    const auto parameters = getParameterSnapshot();
+    return withTopology((TopologyPreset)topology->getIndex(), [&parameters](auto chosen) {
+        return BasicMoorerReverbEngine<float, decltype(chosen)>::getTailLengthSeconds(parameters);
+    });
 }
 
 int MoorerReverbAudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    return (int)std::size(programs);
 }
 
 int MoorerReverbAudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return currentProgram;
 }
 
 void MoorerReverbAudioProcessor::setCurrentProgram (int index)
 {
+    if (index < 0 || index >= getNumPrograms())
+        return;
+
+    /* only the parameters change here: the engine ramps to the new values,
+       and a new topology or eco factor is built in the background and
+       crossfaded to, so the audio thread never waits on a program change */
+    currentProgram = index;
+    const Program& program = programs[index];
+    auto set = [](RangedAudioParameter& parameter, float value) {
+        parameter.setValueNotifyingHost(parameter.convertTo0to1(value));
+    };
+    set(*reverbTime, program.reverbTime);
+    set(*predelay1, program.predelay);
+    set(*damping, program.damping);
+    set(*wetMix, program.wetMix);
+    set(*eco, (float)program.eco);
+    set(*topology, (float)program.topology);
 }
 
 const juce::String MoorerReverbAudioProcessor::getProgramName (int index)
 {
-    return {};
+    if (index < 0 || index >= getNumPrograms())
+        return {};
+    return programs[index].name;
 }
 
 void MoorerReverbAudioProcessor::changeProgramName (int index, const juce::String& newName)
@@ -131,23 +172,34 @@ void MoorerReverbAudioProcessor::changeProgramName (int index, const juce::Strin
 //==============================================================================
 void MoorerReverbAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    /* init delay buffers */
-    delayBufferLength = (int)(0.2*sampleRate); // max delay 200 ms
-    
-    inputDelayBuffer.setSize(2, delayBufferLength);
-    inputDelayBuffer.clear();
-    
-    firDelayBuffer.setSize(2, delayBufferLength);
-    firDelayBuffer.clear();
-    
-    combDelayBuffers.setSize(12, delayBufferLength);
-    combDelayBuffers.clear();
-    
-    combDelayBuffer.setSize(2, delayBufferLength);
-    combDelayBuffer.clear();
-    
-    allpassDelayBuffers.setSize(2, delayBufferLength);
-    allpassDelayBuffers.clear();
+    // only the engine for the host's precision is prepared
+    const int numChannels = jmax(1, getTotalNumInputChannels());
+    if (isUsingDoublePrecision()) {
+        doubleEngine.reserve(getConfiguration<double>(), MOORER_MAX_SAMPLE_RATE, jmax(2, numChannels));
+        doubleEngine.prepare(getConfiguration<double>(), sampleRate, numChannels, samplesPerBlock, getParameterSnapshot());
+    } else {
+        // surround buses need more than the constructor reserved
+        if (numChannels > 2)
+            engine.reserve(getConfiguration<float>(), MOORER_MAX_SAMPLE_RATE, numChannels);
+        engine.prepare(getConfiguration<float>(), sampleRate, numChannels, samplesPerBlock, getParameterSnapshot());
+    }
+
+   #if MOORER_CPU_LOAD_METER
+    loadMeter.prepare(sampleRate);
+   #endif
+   #if MOORER_OUTPUT_ANALYSER
+    outputAnalyser.prepare(sampleRate);
+    if (isUsingDoublePrecision())
+        doubleWetTap.assign((size_t)jmax(1, samplesPerBlock), 0.0);
+    else
+        wetTap.assign((size_t)jmax(1, samplesPerBlock), 0.0f);
+   #endif
+}
+
+template <typename SampleType>
+typename MoorerReverbSwitcher<SampleType>::Configuration MoorerReverbAudioProcessor::getConfiguration() const
+{
+    return { (TopologyPreset)topology->getIndex(), 1 << eco->getIndex(), multicore->get() };
 }
 
 void MoorerReverbAudioProcessor::releaseResources()
@@ -163,12 +215,10 @@ bool MoorerReverbAudioProcessor::isBusesLayoutSupported (const BusesLayout& layo
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // any layout from mono up to MOORER_MAX_CHANNELS: 5.1, 7.1.4, ambisonics
+    // and discrete sets alike, each channel with its own comb delays
+    const int numChannels = layouts.getMainOutputChannelSet().size();
+    if (layouts.getMainOutputChannelSet().isDisabled() || numChannels > MOORER_MAX_CHANNELS)
         return false;
 
     // This checks if the input layout matches the output layout
@@ -183,70 +233,81 @@ bool MoorerReverbAudioProcessor::isBusesLayoutSupported (const BusesLayout& layo
 #endif
 
 void MoorerReverbAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process(engine, buffer);
+}
+
+void MoorerReverbAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process(doubleEngine, buffer);
+}
+
+template <typename SampleType>
+void MoorerReverbAudioProcessor::process (MoorerReverbSwitcher<SampleType>& engineToUse, juce::AudioBuffer<SampleType>& buffer)
 {
     juce::ScopedNoDenormals noDenormals;
+   #if MOORER_CPU_LOAD_METER
+    const CpuLoadMeter::ScopedBlock loadTimer(loadMeter, buffer.getNumSamples());
+   #endif
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
-    const int numSamples = buffer.getNumSamples();
-    const int sampleRate = getSampleRate();
-    int dpr, dpw;
     
     
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
     
     
-    for (int channel = 0; channel < totalNumInputChannels; ++channel) {
-        auto* channelData = buffer.getWritePointer(channel);
-        auto* inputDelayData = inputDelayBuffer.getWritePointer(channel);
-        auto* firDelayData = firDelayBuffer.getWritePointer(channel);
-        auto* combDelayData = combDelayBuffer.getWritePointer(channel);
-        auto* allpassDelayData1 = allpassDelayBuffers.getWritePointer(channel);
-        
-        dpw = delayWrite;
-        
-        for (int sample = 0; sample < numSamples; ++sample) {
-            const float in = channelData[sample];
-            float out = 0.0f;
-            inputDelayData[dpw] = in;
-            firDelayData[dpw] = in;
-            
-            
-            /* FIR DELAY TAPS */
-            for (int i = 0; i < 6; i++) {
-                dpr = (int)(dpw - ((*predelay1)+firDelayLengths[i])*sampleRate + 2*delayBufferLength) % delayBufferLength;
-                float tap = firCoefficients[i] * inputDelayData[dpr];
-                firDelayData[dpw] += tap;
-            }
-            /* ============== */
-            
-
-            /* PARALLEL IIR COMB FILTERS */
-            float combSum = 0.0f;
-            for (int i = 0; i < 6; i++) {
-                float* currentComb = combDelayBuffers.getWritePointer(channel + 2*i);
-                iirCombFilter(currentComb, firDelayData, dpw, iirDelayLengths[i], (*damping)*iirCoefficients[i]);
-                combSum += currentComb[dpw];
-            }
-            combDelayData[dpw] = combSum;
-            /* ========================= */
-            
-            
-            /* ALLPASS SECTION */
-            allpassFilter(allpassDelayData1, combDelayData, dpw, 0.006f);
-            /* =============== */
-            
-            
-            /* this delay lines up first late reflection with the last early reflection (as recommended in [1]) */
-            dpr = (int)(dpw - (0.029f+(*predelay1))*sampleRate + delayBufferLength) % delayBufferLength;
-            out = 0.15f*(firDelayData[dpw] + allpassDelayData1[dpr]);
-            channelData[sample] = (1.0f-(*wetMix))*in + (*wetMix)*out;
-            
-            dpw = (dpw + 1) % delayBufferLength;
-        }
-    }
+    /* parameters are read once per block; the engine ramps towards them
+       and only recomputes its delay offsets when predelay actually changes,
+       and a new topology, eco factor or multicore setting is handed to the
+       background thread */
+    engineToUse.requestConfiguration(getConfiguration<SampleType>());
+    engineToUse.setParameters(getParameterSnapshot());
+
+   #if MOORER_OUTPUT_ANALYSER
+    /* the analyser shows the reverb itself, however much dry signal is mixed
+       in; a block longer than prepareToPlay() promised just isn't shown */
+    auto& tap = [this]() -> std::vector<SampleType>& {
+        if constexpr (std::is_same_v<SampleType, float>)
+            return wetTap;
+        else
+            return doubleWetTap;
+    }();
+    const bool tapped = buffer.getNumSamples() <= (int)tap.size();
+    engineToUse.setWetTap(tapped ? tap.data() : nullptr);
+   #endif
     
-    delayWrite = dpw;
+    engineToUse.process(buffer.getArrayOfWritePointers(), totalNumInputChannels, buffer.getNumSamples());
+
+   #if MOORER_OUTPUT_ANALYSER
+    if (tapped) {
+        const SampleType* wet = tap.data();
+        outputAnalyser.push(&wet, 1, buffer.getNumSamples());
+    }
+   #endif
+}
+
+juce::RangedAudioParameter& MoorerReverbAudioProcessor::getParameterByID (const juce::String& parameterID) const
+{
+    for (auto* parameter : getParameters())
+        if (auto* ranged = dynamic_cast<RangedAudioParameter*>(parameter))
+            if (ranged->getParameterID() == parameterID)
+                return *ranged;
+
+    jassertfalse;   // no parameter has that ID
+    return *reverbTime;
+}
+
+/* the only place the audio thread reads the parameters: once per block,
+   however many times the host or the editor changed them in between */
+MoorerReverbParameters MoorerReverbAudioProcessor::getParameterSnapshot() const
+{
+    MoorerReverbParameters snapshot;
+    snapshot.reverbTime = *reverbTime;
+    snapshot.predelay = *predelay1;
+    snapshot.damping = *damping;
+    snapshot.wetMix = *wetMix;
+    return snapshot;
 }
 
 //==============================================================================
@@ -263,15 +324,31 @@ juce::AudioProcessorEditor* MoorerReverbAudioProcessor::createEditor()
 //==============================================================================
 void MoorerReverbAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
+    // every parameter by ID, in its own units, so ranges can change without breaking old sessions
+    XmlElement state(stateTag);
+    state.setAttribute("program", currentProgram);
+    for (auto* parameter : getParameters())
+        if (auto* ranged = dynamic_cast<RangedAudioParameter*>(parameter))
+            state.setAttribute(ranged->getParameterID(), (double)ranged->convertFrom0to1(ranged->getValue()));
+
+    copyXmlToBinary(state, destData);
 }
 
 void MoorerReverbAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
+    // like a program change, this only sets parameters, so it's safe while playing
+    const auto state = getXmlFromBinary(data, sizeInBytes);
+    if (state == nullptr || ! state->hasTagName(stateTag))
+        return;
+
+    currentProgram = jlimit(0, getNumPrograms() - 1, state->getIntAttribute("program", 0));
+    for (auto* parameter : getParameters()) {
+        if (auto* ranged = dynamic_cast<RangedAudioParameter*>(parameter)) {
+            const auto id = ranged->getParameterID();
+            if (state->hasAttribute(id))
+                ranged->setValueNotifyingHost(ranged->convertTo0to1((float)state->getDoubleAttribute(id)));
+        }
+    }
 }
 
 //==============================================================================
@@ -280,26 +357,3 @@ juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 {
     return new MoorerReverbAudioProcessor();
 }
-
-//==============================================================================
-void MoorerReverbAudioProcessor::iirCombFilter(float* output, float* input, int writePtr, float delay, float feedback)
-{
-    // y[n] = x[n-d] + g*y[n-d]
-    int dpr = (int)(writePtr - delay*getSampleRate() + delayBufferLength) % delayBufferLength;
-    float xd = input[dpr];  // delayed input
-    float fb = output[dpr]; // previous output
-
-    // lowpass feedback line: y[n] = (1-g)*(x[n] + g*x[n-1])
-    dpr = (int)(dpr - 1 + delayBufferLength) % delayBufferLength;
-    float fblp = (1-feedback)*(fb + feedback*(output[dpr]));
-    
-    // uses comb output to dictate reverb time
-    output[writePtr] = (*reverbTime)*(xd + fblp);
-}
-
-void MoorerReverbAudioProcessor::allpassFilter(float* output, float* input, int writePtr, float delay)
-{
-    // y[n] = -g*x[n] + x[n-d] + g*y[n-d]
-    int dpr = (int)(writePtr - delay*getSampleRate() + delayBufferLength) % delayBufferLength;
-    output[writePtr] = -0.7*input[writePtr] + input[dpr] + 0.7*output[dpr];
-}
@@ -9,6 +9,20 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "CpuLoadMeter.h"
+#include "OutputAnalyser.h"
+#include "DSP/MoorerReverbSwitcher.h"
+
+// the highest sample rate the delay lines are reserved for when an instance is
+// created; preparing at or below it never reallocates them
+#ifndef MOORER_MAX_SAMPLE_RATE
+ #define MOORER_MAX_SAMPLE_RATE 96000.0
+#endif
+
+// the widest bus the plugin accepts, enough for 7.1.4 and third-order ambisonics
+#ifndef MOORER_MAX_CHANNELS
+ #define MOORER_MAX_CHANNELS 16
+#endif
 
 using namespace juce;
 
@@ -31,6 +45,8 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override { return true; }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -55,29 +71,59 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
+    /* the parameter with this ID; the editor finds its parameters this way rather than by index */
+    juce::RangedAudioParameter& getParameterByID (const juce::String& parameterID) const;
+
+   #if MOORER_CPU_LOAD_METER
+    /* message thread only; summarises the most recent blocks */
+    CpuLoadMeter::Stats getCpuLoadStats() { return loadMeter.getStats(); }
+   #endif
+
+   #if MOORER_OUTPUT_ANALYSER
+    /* the one editor open at a time is its only reader */
+    OutputAnalyser& getOutputAnalyser() { return outputAnalyser; }
+   #endif
+
 private:
     //==============================================================================
-    juce::AudioBuffer<float> inputDelayBuffer;
-    juce::AudioBuffer<float> firDelayBuffer;
-    juce::AudioBuffer<float> combDelayBuffers;
-    juce::AudioBuffer<float> combDelayBuffer;
-    juce::AudioBuffer<float> allpassDelayBuffers;
+    /* only the one for the host's precision is prepared; a new topology, eco
+       factor or multicore setting is built in the background and crossfaded to */
+    MoorerReverbSwitcher<float> engine;
+    MoorerReverbSwitcher<double> doubleEngine;
+
+    int currentProgram {0};
+
+   #if MOORER_CPU_LOAD_METER
+    CpuLoadMeter loadMeter;
+   #endif
+
+   #if MOORER_OUTPUT_ANALYSER
+    OutputAnalyser outputAnalyser;
+    // the engine's wet signal, which is what the analyser shows, for a block of the host's precision
+    std::vector<float> wetTap;
+    std::vector<double> doubleWetTap;
+   #endif
+
+   #if MOORER_STAGE_PROFILER
+    // only created when the MOORER_TRACE_FILE environment variable names a file to write
+    std::unique_ptr<StageProfiler> stageProfiler;
+    std::unique_ptr<ChromeTraceWriter> traceWriter;
+   #endif
     
     juce::AudioParameterFloat* reverbTime;
     juce::AudioParameterFloat* predelay1;
     juce::AudioParameterFloat* damping;
     juce::AudioParameterFloat* wetMix;
+    juce::AudioParameterChoice* eco;
+    juce::AudioParameterChoice* topology;
+    juce::AudioParameterBool* multicore;
     
-    int delayBufferLength, sampleRate;
-    int delayWrite {0};
-    
-    float iirDelayLengths[6];
-    float iirCoefficients[6];
-    float firDelayLengths[6];
-    float firCoefficients[6];
-    
-    void iirCombFilter (float* dest, float* input, int writePtr, float delay, float feedback);
-    void allpassFilter(float* output, float* input, int writePtr, float delay);
+    MoorerReverbParameters getParameterSnapshot() const;
+
+    template <typename SampleType>
+    typename MoorerReverbSwitcher<SampleType>::Configuration getConfiguration() const;
+    template <typename SampleType>
+    void process (MoorerReverbSwitcher<SampleType>& engineToUse, juce::AudioBuffer<SampleType>& buffer);
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MoorerReverbAudioProcessor)
 };
@@ -0,0 +1,825 @@
+/*
+  ==============================================================================
+
+    NullTest.cpp
+
+    Renders an impulse, white noise and a logarithmic sine sweep through
+    every engine variant and kernel instruction set, at several sample
+    rates, block sizes and parameter settings, and nulls each against the
+    frozen ReferenceReverb. It reports the largest sample error, the null
+    depth (reference level over residual level), the difference in overall
+    level and, from the impulse, how far the RT60 strays from the
+    reference's. Exits non-zero if any case breaks its variant's tolerances.
+
+    Full-rate variants must match the reference to float rounding; the
+    double-precision engine gets the same float input and is converted back
+    to float to compare, so it is held to the same. Eco modes
+    round the comb lengths at a lower rate and lowpass the late reverb, so
+    their output doesn't null at all; both sides are lowpassed to the band
+    eco keeps, and held to the level and the decay time in that band.
+
+    The reference stops at stereo, so a 12-channel layout is checked apart:
+    its first pair has to null like stereo does, and each further channel,
+    on comb delays of its own, has to decay within their spread of the
+    reference's RT60.
+
+    Every variant is then checkpointed with saveState() and restoreState()
+    mid-render, in stereo and 12 channels, and has to carry on bit-exactly.
+    With the reverb time and damping automated mid-render, every full-rate
+    variant on every instruction set has to match the scalar engine bit for
+    bit.
+
+    Schroeder's and the dense topology have no reference, so each is held
+    to itself instead: every full-rate variant on every instruction set has
+    to match its scalar engine bit for bit, the double engine has to stay
+    within two float steps of it, and its tail has to stay finite and decay.
+    Each instance of a MoorerReverbBank, with parameters of its own, has to
+    match a mono engine bit for bit. Finally a pipeline job the worker has
+    claimed is held up well past the spin limit, and collecting it has to
+    block until it's done rather than spin.
+
+    null_test [--quick] [--verbose]
+
+  ==============================================================================
+*/
+
+#include "DSP/MoorerReverbBank.h"
+#include "DSP/MoorerReverbEngine.h"
+#include "DSP/PipelineWorker.h"
+#include "ReferenceReverb.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    constexpr double pi = 3.14159265358979323846;
+
+    struct Tolerance
+    {
+        double maxAbsError;
+        double minNullDepth;        // dB
+        double maxLevelDifference;  // dB
+        double maxRt60Deviation;    // fraction of the reference RT60
+    };
+
+    const Tolerance exactTolerance { 1.0e-4, 80.0, 0.001, 0.001 };
+    const Tolerance ecoTolerance   { HUGE_VAL, -HUGE_VAL, 2.5, 0.1 };
+
+    // topologies the reference doesn't cover; two float steps at full scale
+    const double maxDoubleError = 2.5e-7;
+    const double minTailDecay = 60.0;           // dB, over the 2.5 s after a burst
+
+    struct Variant
+    {
+        const char* name;
+        MoorerReverbEngine::CombEngine combEngine;
+        bool interleave;
+        bool stereoOnly;
+        int decimation;
+        bool doublePrecision;
+        bool pipelined;
+    };
+
+    const Variant variants[] = {
+        { "scalar",             MoorerReverbEngine::CombEngine::scalar, false, false, 1, false, false },
+        { "simd",               MoorerReverbEngine::CombEngine::simd,   false, false, 1, false, false },
+        { "scalar-interleaved", MoorerReverbEngine::CombEngine::scalar, true,  true,  1, false, false },
+        { "simd-interleaved",   MoorerReverbEngine::CombEngine::simd,   true,  true,  1, false, false },
+        { "scalar-eco2",        MoorerReverbEngine::CombEngine::scalar, false, false, 2, false, false },
+        { "scalar-eco4",        MoorerReverbEngine::CombEngine::scalar, false, false, 4, false, false },
+        { "double",             MoorerReverbEngine::CombEngine::scalar, false, false, 1, true,  false },
+        { "double-interleaved", MoorerReverbEngine::CombEngine::scalar, true,  true,  1, true,  false },
+        { "pipelined",          MoorerReverbEngine::CombEngine::scalar, false, false, 1, false, true  },
+        { "simd-pipelined",     MoorerReverbEngine::CombEngine::simd,   true,  true,  1, false, true  },
+        { "eco4-pipelined",     MoorerReverbEngine::CombEngine::scalar, false, false, 4, false, true  },
+    };
+
+    struct Setting
+    {
+        const char* name;
+        MoorerReverbParameters parameters;
+    };
+
+    const Setting settings[] = {
+        { "default", { 0.875f, 0.02f, 0.7f, 1.0f } },
+        { "long",    { 0.97f, 0.08f, 0.2f, 0.6f } },
+        { "damped",  { 0.6f, 0.0005f, 1.8f, 1.0f } },
+    };
+
+    enum class Signal { impulse, noise, sweep };
+    const char* signalNames[] = { "impulse", "noise", "sweep" };
+
+    /* two channels of input; the right one differs so a mixed-up stereo
+       pair can't null */
+    std::vector<std::vector<float>> makeInput(Signal signal, double sampleRate, double seconds)
+    {
+        const int length = (int)(seconds*sampleRate);
+        std::vector<std::vector<float>> input(2, std::vector<float>((size_t)length, 0.0f));
+
+        if (signal == Signal::impulse) {
+            input[0][0] = 1.0f;
+            input[1][(size_t)std::min(length - 1, 101)] = -0.5f;
+        } else if (signal == Signal::noise) {
+            std::mt19937 rng(7);
+            std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+            for (auto& channel : input)
+                for (auto& x : channel)
+                    x = noise(rng);
+        } else {
+            // 20 Hz up to 0.45 fs, with the right channel sweeping down
+            const double f0 = 20.0, f1 = 0.45*sampleRate, duration = (double)length/sampleRate;
+            const double k = std::log(f1/f0);
+            for (int n = 0; n < length; ++n) {
+                const double t = (double)n/sampleRate;
+                const double up = 2.0*pi*f0*duration/k*(std::exp(t/duration*k) - 1.0);
+                const double down = 2.0*pi*f0*duration/k*(std::exp((duration - t)/duration*k) - 1.0);
+                input[0][(size_t)n] = (float)(0.5*std::sin(up));
+                input[1][(size_t)n] = (float)(0.5*std::sin(down));
+            }
+        }
+        return input;
+    }
+
+    std::vector<std::vector<float>> renderReference(const std::vector<std::vector<float>>& input, int numChannels,
+                                                    double sampleRate, const MoorerReverbParameters& p)
+    {
+        ReferenceReverb reference;
+        reference.reverbTime = p.reverbTime;
+        reference.predelay1 = p.predelay;
+        reference.damping = p.damping;
+        reference.wetMix = p.wetMix;
+        reference.prepare(sampleRate);
+
+        std::vector<std::vector<float>> output(input.begin(), input.begin() + numChannels);
+        std::vector<float*> pointers;
+        for (auto& channel : output)
+            pointers.push_back(channel.data());
+
+        // in the largest blocks the original accepted; it didn't care about the size
+        const int length = (int)output[0].size();
+        for (int done = 0; done < length; done += 4096) {
+            std::vector<float*> block;
+            for (auto* p : pointers)
+                block.push_back(p + done);
+            reference.process(block.data(), numChannels, std::min(4096, length - done));
+        }
+        return output;
+    }
+
+    template <typename SampleType, typename Topology = MoorerTopology>
+    std::vector<std::vector<float>> renderEngine(const std::vector<std::vector<float>>& input, int numChannels,
+                                                 double sampleRate, const MoorerReverbParameters& p,
+                                                 const Variant& variant, DspKernels::Isa isa, int blockSize)
+    {
+        BasicMoorerReverbEngine<SampleType, Topology> engine;
+        engine.setIsa(isa);
+        engine.setCombEngine(variant.combEngine);
+        engine.setInterleaveChannels(variant.interleave);
+        engine.setDecimation(variant.decimation);
+        engine.setPipelined(variant.pipelined);
+        engine.setParameters(p);
+        engine.prepare(sampleRate, numChannels);
+
+        std::vector<std::vector<SampleType>> buffer;
+        for (int channel = 0; channel < numChannels; ++channel)
+            buffer.emplace_back(input[(size_t)channel].begin(), input[(size_t)channel].end());
+
+        const int length = (int)buffer[0].size();
+        std::vector<SampleType*> block((size_t)numChannels);
+        for (int done = 0; done < length; done += blockSize) {
+            for (int channel = 0; channel < numChannels; ++channel)
+                block[(size_t)channel] = buffer[(size_t)channel].data() + done;
+            engine.process(block.data(), numChannels, std::min(blockSize, length - done));
+        }
+
+        std::vector<std::vector<float>> output;
+        for (auto& channel : buffer)
+            output.emplace_back(channel.begin(), channel.end());
+        return output;
+    }
+
+    /* noise, a change of setting and then silence, rendered straight through
+       and again with the engine saved and restored into a fresh one at each
+       checkpoint: mid-glide, and once it has gone to sleep. The fresh engine
+       is never pipelined, so a pipelined engine's state has to carry over
+       too. Returns what went wrong, or nothing */
+    template <typename SampleType>
+    std::string checkCheckpoints(const Variant& variant, int numChannels, double sampleRate)
+    {
+        using Engine = BasicMoorerReverbEngine<SampleType>;
+        auto makeEngine = [&](bool pipelined, double rate) {
+            auto engine = std::make_unique<Engine>();
+            engine->setCombEngine(variant.combEngine);
+            engine->setInterleaveChannels(variant.interleave);
+            engine->setDecimation(variant.decimation);
+            engine->setPipelined(pipelined);
+            engine->setParameters(settings[0].parameters);
+            engine->prepare(rate, numChannels);
+            return engine;
+        };
+
+        constexpr int blockSize = 480;
+        const MoorerReverbParameters& later = settings[2].parameters;
+        const int change = (int)(0.5*sampleRate)/blockSize*blockSize;
+        const int length = (int)((0.6 + Engine::getTailLengthSeconds(later) + 1.0)*sampleRate);
+        const int checkpoints[] = { change + 10*blockSize, length/blockSize*blockSize - 2*blockSize };
+
+        std::mt19937 rng(11);
+        std::uniform_real_distribution<SampleType> noise(-0.5, 0.5);
+        std::vector<std::vector<SampleType>> straight((size_t)numChannels, std::vector<SampleType>((size_t)length));
+        for (auto& channel : straight)
+            for (int n = 0; n < (int)(0.6*sampleRate); ++n)
+                channel[(size_t)n] = noise(rng);
+        auto restored = straight;
+
+        auto render = [&](Engine& engine, std::vector<std::vector<SampleType>>& buffer, int from, int to) {
+            std::vector<SampleType*> block((size_t)numChannels);
+            for (int done = from; done < to; done += blockSize) {
+                for (int channel = 0; channel < numChannels; ++channel)
+                    block[(size_t)channel] = buffer[(size_t)channel].data() + done;
+                engine.setParameters(done >= change ? later : settings[0].parameters);
+                engine.process(block.data(), numChannels, std::min(blockSize, to - done));
+            }
+        };
+
+        render(*makeEngine(variant.pipelined, sampleRate), straight, 0, length);
+
+        auto engine = makeEngine(variant.pipelined, sampleRate);
+        int done = 0;
+        std::vector<unsigned char> state;
+        for (const int checkpoint : checkpoints) {
+            render(*engine, restored, done, checkpoint);
+            done = checkpoint;
+            if (checkpoint == checkpoints[1] && ! engine->isSleeping())
+                return "never went to sleep";
+
+            engine->saveState(state);
+            if (makeEngine(false, sampleRate*2.0)->restoreState(state.data(), state.size()))
+                return "restored into an engine prepared at another rate";
+            auto damaged = state;
+            damaged[damaged.size()/2] ^= 1;
+            if (makeEngine(false, sampleRate)->restoreState(damaged.data(), damaged.size()))
+                return "restored damaged state";
+
+            engine = makeEngine(false, sampleRate);
+            if (! engine->restoreState(state.data(), state.size()))
+                return "couldn't restore its own state";
+        }
+        render(*engine, restored, done, length);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            if (std::memcmp(straight[(size_t)channel].data(), restored[(size_t)channel].data(), (size_t)length*sizeof(SampleType)) != 0)
+                return "carried on differently after restoring";
+        return {};
+    }
+
+    /* a bank of a full group and a partial one, each instance with noise and
+       parameters of its own set before prepare(), against one mono engine
+       per instance: every lane has to match it bit for bit. Returns what went
+       wrong, or nothing */
+    std::string checkBank(double sampleRate, int blockSize, double seconds)
+    {
+        constexpr int numInstances = MoorerReverbBank::groupLanes + 3;
+        const int length = (int)(seconds*sampleRate);
+
+        MoorerReverbBank bank;
+        std::vector<MoorerReverbParameters> parameters((size_t)numInstances);
+        std::vector<std::vector<float>> input((size_t)numInstances, std::vector<float>((size_t)length));
+        for (int i = 0; i < numInstances; ++i) {
+            auto& p = parameters[(size_t)i];
+            p.reverbTime = 0.5f + 0.045f*(float)i;
+            p.damping = 0.15f*(float)i;
+            p.wetMix = 0.3f + 0.06f*(float)i;
+            p.predelay = 0.0005f + 0.009f*(float)i;
+            bank.setParameters(i, p);
+
+            std::mt19937 rng((unsigned)(100 + i));
+            std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+            for (auto& x : input[(size_t)i])
+                x = noise(rng);
+        }
+        bank.prepare(sampleRate, numInstances);
+
+        // in place, as the bank allows
+        auto banked = input;
+        std::vector<float*> pointers((size_t)numInstances);
+        for (int done = 0; done < length; done += blockSize) {
+            for (int i = 0; i < numInstances; ++i)
+                pointers[(size_t)i] = banked[(size_t)i].data() + done;
+            bank.process(pointers.data(), pointers.data(), std::min(blockSize, length - done));
+        }
+
+        const Variant scalar = variants[0];
+        for (int i = 0; i < numInstances; ++i) {
+            const auto mono = renderEngine<float>({ input[(size_t)i] }, 1, sampleRate, parameters[(size_t)i], scalar,
+                                                  DspKernels::best().isa, blockSize);
+            if (std::memcmp(mono[0].data(), banked[(size_t)i].data(), (size_t)length*sizeof(float)) != 0)
+                return "instance " + std::to_string(i) + " differs from a mono engine";
+        }
+        return {};
+    }
+
+    /* the reference only knows Moorer's topology, so the others are held to
+       themselves: on noise and then silence, every full-rate float variant on
+       every instruction set has to match the scalar engine bit for bit, the
+       double engine has to stay within maxDoubleError of it, and the tail has
+       to stay finite and die away. Returns what went wrong, or nothing */
+    template <typename Topology>
+    std::string checkTopology(const std::vector<DspKernels::Isa>& isas, double sampleRate, int blockSize)
+    {
+        constexpr double seconds = 3.0, burst = 0.5;
+        const MoorerReverbParameters& p = settings[0].parameters;
+        auto input = makeInput(Signal::noise, sampleRate, seconds);
+        for (auto& channel : input)
+            std::fill(channel.begin() + (int)(burst*sampleRate), channel.end(), 0.0f);
+
+        const auto scalar = renderEngine<float, Topology>(input, 2, sampleRate, p, variants[0], isas.front(), blockSize);
+
+        const int window = (int)(burst*sampleRate);
+        auto energy = [&](int from) {
+            double e = 0.0;
+            for (auto& channel : scalar)
+                for (int n = from; n < from + window; ++n)
+                    e += (double)channel[(size_t)n]*channel[(size_t)n];
+            return e;
+        };
+        for (auto& channel : scalar)
+            for (const float x : channel)
+                if (! std::isfinite(x))
+                    return "output isn't finite";
+        const double early = energy(window), late = energy((int)scalar[0].size() - window);
+        if (! (early > 0.0) || late > early*std::pow(10.0, -minTailDecay/10.0))
+            return "tail doesn't die away";
+
+        for (const auto& variant : variants) {
+            if (variant.decimation > 1 || variant.doublePrecision)
+                continue;
+            if (variant.combEngine == MoorerReverbEngine::CombEngine::simd && ! CombBank::hasSimdKernel())
+                continue;
+
+            for (const auto isa : isas) {
+                const auto output = renderEngine<float, Topology>(input, 2, sampleRate, p, variant, isa, blockSize);
+                for (size_t channel = 0; channel < output.size(); ++channel)
+                    if (std::memcmp(output[channel].data(), scalar[channel].data(), scalar[channel].size()*sizeof(float)) != 0)
+                        return std::string(variant.name) + " on " + DspKernels::getIsaName(isa) + " differs from scalar";
+            }
+        }
+
+        const auto precise = renderEngine<double, Topology>(input, 2, sampleRate, p, variants[6], isas.front(), blockSize);
+        double error = 0.0;
+        for (size_t channel = 0; channel < precise.size(); ++channel)
+            for (size_t n = 0; n < precise[channel].size(); ++n)
+                error = std::max(error, std::abs((double)precise[channel][n] - scalar[channel][n]));
+        if (error > maxDoubleError) {
+            char problem[64];
+            std::snprintf(problem, sizeof(problem), "double is off float by %.3g", error);
+            return problem;
+        }
+        return {};
+    }
+
+    /* noise with the reverb time and damping automated on every block, one,
+       the other or both at a time, with rests long enough for the glides to
+       settle in between, so the combs run both their ramped and their steady
+       paths. Every full-rate float variant, the comb bank's above all, has to
+       match the scalar engine bit for bit on every instruction set. Returns
+       what went wrong, or nothing */
+    std::string checkAutomation(const std::vector<DspKernels::Isa>& isas, int numChannels, double sampleRate, int blockSize)
+    {
+        const int length = (int)(2.0*sampleRate);
+        std::mt19937 rng(13);
+        std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+        std::vector<std::vector<float>> input((size_t)numChannels, std::vector<float>((size_t)length));
+        for (auto& channel : input)
+            for (auto& x : channel)
+                x = noise(rng);
+
+        auto render = [&](const Variant& variant, DspKernels::Isa isa) {
+            MoorerReverbEngine engine;
+            engine.setIsa(isa);
+            engine.setCombEngine(variant.combEngine);
+            engine.setInterleaveChannels(variant.interleave);
+            engine.setPipelined(variant.pipelined);
+            engine.setParameters(settings[0].parameters);
+            engine.prepare(sampleRate, numChannels);
+
+            auto buffer = input;
+            std::vector<float*> block((size_t)numChannels);
+            for (int done = 0, index = 0; done < length; done += blockSize, ++index) {
+                // a quarter of a second each: resting, both moving, then the reverb time, then the damping
+                const int phase = (int)(done/(0.25*sampleRate)) % 4;
+                MoorerReverbParameters p = settings[0].parameters;
+                if (phase == 1 || phase == 2)
+                    p.reverbTime = 0.7f + 0.25f*(float)std::sin(0.3*index);
+                if (phase == 1 || phase == 3)
+                    p.damping = 0.9f + 0.85f*(float)std::sin(0.17*index);
+                engine.setParameters(p);
+
+                for (int channel = 0; channel < numChannels; ++channel)
+                    block[(size_t)channel] = buffer[(size_t)channel].data() + done;
+                engine.process(block.data(), numChannels, std::min(blockSize, length - done));
+            }
+            return buffer;
+        };
+
+        const auto scalar = render(variants[0], isas.front());
+        for (const auto& variant : variants) {
+            if (variant.decimation > 1 || variant.doublePrecision || (variant.stereoOnly && numChannels != 2))
+                continue;
+            if (variant.combEngine == MoorerReverbEngine::CombEngine::simd && ! CombBank::hasSimdKernel())
+                continue;
+
+            for (const auto isa : isas) {
+                const auto output = render(variant, isa);
+                for (int channel = 0; channel < numChannels; ++channel)
+                    if (std::memcmp(output[(size_t)channel].data(), scalar[(size_t)channel].data(), (size_t)length*sizeof(float)) != 0)
+                        return std::string(variant.name) + " on " + DspKernels::getIsaName(isa) + " differs from scalar";
+            }
+        }
+        return {};
+    }
+
+    /* a job that, once the worker has claimed it, is held up for 20 ms, as if
+       the worker had been preempted: collect() has to give up spinning, wait,
+       and return only once the job is done. Returns what went wrong, or nothing */
+    std::string checkStalledWorker()
+    {
+        struct Context
+        {
+            std::atomic<bool> started {false};
+            std::atomic<int> result {0};
+        } context;
+
+        PipelineWorker worker;
+        worker.post([](void* c) {
+            auto& context = *static_cast<Context*>(c);
+            context.started = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            context.result = 1;
+        }, &context);
+
+        while (! context.started)
+            std::this_thread::yield();
+        worker.collect();
+
+        if (context.result != 1)
+            return "collect() returned before the job was done";
+        if (worker.getNumLate() != 1 || worker.getNumStalled() != 1)
+            return "the wait wasn't counted as a stall";
+
+        // and it carries on taking jobs afterwards
+        worker.post([](void* c) { static_cast<Context*>(c)->result = 2; }, &context);
+        worker.collect();
+        if (context.result != 2)
+            return "the next job didn't run";
+        return {};
+    }
+
+    /* a fourth-order Butterworth lowpass (two RBJ biquads), run over each channel */
+    std::vector<std::vector<float>> lowpass(std::vector<std::vector<float>> signal, double cutoff, double sampleRate)
+    {
+        const double w = 2.0*pi*cutoff/sampleRate;
+        for (const double q : { 0.5411961, 1.3065630 }) {
+            const double alpha = std::sin(w)/(2.0*q), cosw = std::cos(w), a0 = 1.0 + alpha;
+            const double b0 = (1.0 - cosw)/2.0/a0, b1 = (1.0 - cosw)/a0, b2 = b0;
+            const double a1 = -2.0*cosw/a0, a2 = (1.0 - alpha)/a0;
+
+            for (auto& channel : signal) {
+                double x1 = 0.0, x2 = 0.0, y1 = 0.0, y2 = 0.0;
+                for (auto& x : channel) {
+                    const double y = b0*x + b1*x1 + b2*x2 - a1*y1 - a2*y2;
+                    x2 = x1; x1 = x;
+                    y2 = y1; y1 = y;
+                    x = (float)y;
+                }
+            }
+        }
+        return signal;
+    }
+
+    /* Schroeder backward integration of the squared response, with a line
+       fitted from -5 to -35 dB and extrapolated to -60 dB */
+    double rt60(const std::vector<std::vector<float>>& response, double sampleRate)
+    {
+        const size_t length = response[0].size();
+        std::vector<double> energy(length + 1, 0.0);
+        for (size_t n = length; n-- > 0;) {
+            double e = 0.0;
+            for (auto& channel : response)
+                e += (double)channel[n]*channel[n];
+            energy[n] = energy[n + 1] + e;
+        }
+        if (energy[0] <= 0.0)
+            return 0.0;
+
+        double sumT = 0.0, sumL = 0.0, sumTT = 0.0, sumTL = 0.0;
+        int count = 0;
+        for (size_t n = 0; n < length; ++n) {
+            const double level = 10.0*std::log10(std::max(energy[n], 1.0e-300)/energy[0]);
+            if (level > -5.0)
+                continue;
+            if (level < -35.0)
+                break;
+            const double t = (double)n/sampleRate;
+            sumT += t; sumL += level; sumTT += t*t; sumTL += t*level;
+            ++count;
+        }
+        if (count < 2)
+            return 0.0;
+
+        const double slope = (count*sumTL - sumT*sumL)/(count*sumTT - sumT*sumT);
+        return slope < 0.0 ? -60.0/slope : 0.0;
+    }
+
+    struct Comparison
+    {
+        double maxAbsError {0.0};
+        double nullDepth {300.0};
+        double levelDifference {0.0};
+        double rt60Deviation {0.0};
+    };
+
+    Comparison compare(const std::vector<std::vector<float>>& reference, const std::vector<std::vector<float>>& output,
+                       double referenceRt60, double sampleRate, bool impulse)
+    {
+        Comparison c;
+        double signal = 0.0, residual = 0.0, level = 0.0;
+        for (size_t channel = 0; channel < reference.size(); ++channel) {
+            for (size_t n = 0; n < reference[channel].size(); ++n) {
+                const double error = (double)output[channel][n] - reference[channel][n];
+                c.maxAbsError = std::max(c.maxAbsError, std::abs(error));
+                signal += (double)reference[channel][n]*reference[channel][n];
+                level += (double)output[channel][n]*output[channel][n];
+                residual += error*error;
+            }
+        }
+        if (residual > 0.0)
+            c.nullDepth = std::min(300.0, 10.0*std::log10(signal/residual));
+        if (signal > 0.0 && level > 0.0)
+            c.levelDifference = std::abs(10.0*std::log10(level/signal));
+
+        if (impulse && referenceRt60 > 0.0)
+            c.rt60Deviation = std::abs(rt60(output, sampleRate) - referenceRt60)/referenceRt60;
+        return c;
+    }
+
+    bool withinTolerance(const Comparison& c, const Tolerance& t)
+    {
+        return c.maxAbsError <= t.maxAbsError && c.nullDepth >= t.minNullDepth
+            && c.levelDifference <= t.maxLevelDifference && c.rt60Deviation <= t.maxRt60Deviation;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool quick = false, verbose = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (std::strcmp(argv[i], "--verbose") == 0) {
+            verbose = true;
+        } else {
+            std::fprintf(stderr, "usage: %s [--quick] [--verbose]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<double> sampleRates { 44100.0, 48000.0, 96000.0 };
+    std::vector<int> blockSizes { 1, 64, 480, 4096 };
+    // long enough for the impulse to fall well past -35 dB at the longest setting
+    const double seconds = 3.0;
+    if (quick) {
+        sampleRates = { 48000.0 };
+        blockSizes = { 64, 4096 };
+    }
+
+    std::vector<DspKernels::Isa> isas;
+    for (int i = 0; i < DspKernels::numIsas; ++i)
+        if (DspKernels::forIsa((DspKernels::Isa)i) != nullptr)
+            isas.push_back((DspKernels::Isa)i);
+
+    std::printf("%-8s %-8s %-8s %-20s %3s %12s %9s %9s %9s\n",
+                "rate", "setting", "signal", "variant", "ch", "max error", "null dB", "level dB", "rt60 dev");
+
+    int numCases = 0, numFailures = 0;
+    for (const double sampleRate : sampleRates) {
+        for (const auto& setting : settings) {
+            for (const Signal signal : { Signal::impulse, Signal::noise, Signal::sweep }) {
+                const auto input = makeInput(signal, sampleRate, seconds);
+
+                for (const int numChannels : { 1, 2 }) {
+                    const auto fullReference = renderReference(input, numChannels, sampleRate, setting.parameters);
+                    const bool impulse = signal == Signal::impulse;
+
+                    for (const auto& variant : variants) {
+                        if (variant.stereoOnly && numChannels != 2)
+                            continue;
+                        if (variant.combEngine == MoorerReverbEngine::CombEngine::simd && ! CombBank::hasSimdKernel())
+                            continue;
+
+                        // eco keeps what its halfbands pass flat: 0.15 of each stage's input rate
+                        const bool eco = variant.decimation > 1;
+                        const double band = 0.3*sampleRate/variant.decimation;
+                        const auto reference = eco ? lowpass(fullReference, band, sampleRate) : fullReference;
+                        const double referenceRt60 = impulse ? rt60(reference, sampleRate) : 0.0;
+
+                        const Tolerance& tolerance = eco ? ecoTolerance : exactTolerance;
+                        Comparison worst;
+                        bool failed = false;
+
+                        for (const auto isa : isas) {
+                            // the double engine has no dispatched kernels, so one pass covers it
+                            if (variant.doublePrecision && isa != isas.front())
+                                continue;
+
+                            for (const int blockSize : blockSizes) {
+                                auto output = variant.doublePrecision
+                                            ? renderEngine<double>(input, numChannels, sampleRate, setting.parameters,
+                                                                   variant, isa, blockSize)
+                                            : renderEngine<float>(input, numChannels, sampleRate, setting.parameters,
+                                                                  variant, isa, blockSize);
+                                if (eco)
+                                    output = lowpass(output, band, sampleRate);
+                                const Comparison c = compare(reference, output, referenceRt60, sampleRate, impulse);
+                                ++numCases;
+
+                                if (! withinTolerance(c, tolerance)) {
+                                    failed = true;
+                                    ++numFailures;
+                                    std::printf("FAIL %.0f Hz %s %s %s %dch %s block %d: error %.3g, null %.1f dB, "
+                                                "level off by %.2f dB, rt60 off by %.2f%%\n",
+                                                sampleRate, setting.name, signalNames[(int)signal], variant.name, numChannels,
+                                                DspKernels::getIsaName(isa), blockSize, c.maxAbsError, c.nullDepth,
+                                                c.levelDifference, 100.0*c.rt60Deviation);
+                                } else if (verbose) {
+                                    std::printf("  %s block %d: error %.3g, null %.1f dB\n",
+                                                DspKernels::getIsaName(isa), blockSize, c.maxAbsError, c.nullDepth);
+                                }
+
+                                worst.maxAbsError = std::max(worst.maxAbsError, c.maxAbsError);
+                                worst.nullDepth = std::min(worst.nullDepth, c.nullDepth);
+                                worst.levelDifference = std::max(worst.levelDifference, c.levelDifference);
+                                worst.rt60Deviation = std::max(worst.rt60Deviation, c.rt60Deviation);
+                            }
+                        }
+
+                        std::printf("%-8.0f %-8s %-8s %-20s %3d %12.3g %9.1f %9.3f %8.2f%%%s\n",
+                                    sampleRate, setting.name, signalNames[(int)signal], variant.name, numChannels,
+                                    worst.maxAbsError, worst.nullDepth, worst.levelDifference, 100.0*worst.rt60Deviation,
+                                    failed ? "  FAIL" : "");
+                    }
+                }
+            }
+        }
+    }
+
+    // the fit itself wanders by a few percent as the comb lengths change
+    constexpr int numWideChannels = 12;
+    const double maxWideRt60Deviation = (double)MoorerReverbEngine::maxChannelSpread - 1.0 + 0.05;
+    for (const double sampleRate : sampleRates) {
+        for (const auto& setting : settings) {
+            const auto stereoInput = makeInput(Signal::impulse, sampleRate, seconds);
+            std::vector<std::vector<float>> input;
+            for (int channel = 0; channel < numWideChannels; ++channel)
+                input.push_back(stereoInput[(size_t)(channel % 2)]);
+
+            const auto reference = renderReference(stereoInput, 2, sampleRate, setting.parameters);
+            const double referenceRt60 = rt60(reference, sampleRate);
+
+            for (const auto& variant : variants) {
+                if (variant.decimation > 1)
+                    continue;
+                if (variant.combEngine == MoorerReverbEngine::CombEngine::simd && ! CombBank::hasSimdKernel())
+                    continue;
+
+                for (const auto isa : isas) {
+                    if (variant.doublePrecision && isa != isas.front())
+                        continue;
+
+                    const auto output = variant.doublePrecision
+                                      ? renderEngine<double>(input, numWideChannels, sampleRate, setting.parameters,
+                                                             variant, isa, blockSizes.front())
+                                      : renderEngine<float>(input, numWideChannels, sampleRate, setting.parameters,
+                                                            variant, isa, blockSizes.front());
+                    const std::vector<std::vector<float>> pair(output.begin(), output.begin() + 2);
+                    const Comparison c = compare(reference, pair, referenceRt60, sampleRate, true);
+                    bool failed = ! withinTolerance(c, exactTolerance);
+
+                    double worstDeviation = 0.0;
+                    for (int channel = 2; channel < numWideChannels; ++channel) {
+                        const double channelRt60 = rt60({ output[(size_t)channel] }, sampleRate);
+                        worstDeviation = std::max(worstDeviation, std::abs(channelRt60 - referenceRt60)/referenceRt60);
+                    }
+                    failed = failed || worstDeviation > maxWideRt60Deviation;
+                    ++numCases;
+
+                    if (failed) {
+                        ++numFailures;
+                        std::printf("FAIL %.0f Hz %s %s %dch %s: pair error %.3g, null %.1f dB, "
+                                    "other channels' rt60 off by up to %.2f%%\n",
+                                    sampleRate, setting.name, variant.name, numWideChannels, DspKernels::getIsaName(isa),
+                                    c.maxAbsError, c.nullDepth, 100.0*worstDeviation);
+                    } else if (verbose) {
+                        std::printf("  %dch %s %s: pair error %.3g, rt60 off by up to %.2f%%\n", numWideChannels,
+                                    variant.name, DspKernels::getIsaName(isa), c.maxAbsError, 100.0*worstDeviation);
+                    }
+                }
+            }
+        }
+    }
+
+    for (const double sampleRate : sampleRates) {
+        for (const auto& variant : variants) {
+            if (variant.combEngine == MoorerReverbEngine::CombEngine::simd && ! CombBank::hasSimdKernel())
+                continue;
+
+            for (const int numChannels : { 2, numWideChannels }) {
+                const std::string problem = variant.doublePrecision
+                                          ? checkCheckpoints<double>(variant, numChannels, sampleRate)
+                                          : checkCheckpoints<float>(variant, numChannels, sampleRate);
+                ++numCases;
+
+                if (! problem.empty()) {
+                    ++numFailures;
+                    std::printf("FAIL %.0f Hz %s %dch checkpoint: %s\n", sampleRate, variant.name, numChannels, problem.c_str());
+                } else if (verbose) {
+                    std::printf("  %dch %s: restored bit-exactly\n", numChannels, variant.name);
+                }
+            }
+        }
+    }
+
+    for (const double sampleRate : sampleRates) {
+        for (const int blockSize : blockSizes) {
+            for (const int numChannels : { 2, numWideChannels }) {
+                const std::string problem = checkAutomation(isas, numChannels, sampleRate, blockSize);
+                ++numCases;
+
+                if (! problem.empty()) {
+                    ++numFailures;
+                    std::printf("FAIL %.0f Hz %dch automated block %d: %s\n", sampleRate, numChannels, blockSize, problem.c_str());
+                } else if (verbose) {
+                    std::printf("  %dch automated block %d: every variant bit-identical\n", numChannels, blockSize);
+                }
+            }
+        }
+    }
+
+    for (const double sampleRate : sampleRates) {
+        for (const int blockSize : blockSizes) {
+            const std::pair<const char*, std::string> topologies[] = {
+                { "schroeder", checkTopology<SchroederTopology>(isas, sampleRate, blockSize) },
+                { "dense",     checkTopology<DenseTopology>(isas, sampleRate, blockSize) },
+            };
+            for (const auto& [name, problem] : topologies) {
+                ++numCases;
+                if (! problem.empty()) {
+                    ++numFailures;
+                    std::printf("FAIL %.0f Hz %s block %d: %s\n", sampleRate, name, blockSize, problem.c_str());
+                } else if (verbose) {
+                    std::printf("  %s block %d: every variant bit-identical\n", name, blockSize);
+                }
+            }
+        }
+    }
+
+    for (const double sampleRate : sampleRates) {
+        for (const int blockSize : blockSizes) {
+            const std::string problem = checkBank(sampleRate, blockSize, 1.5);
+            ++numCases;
+
+            if (! problem.empty()) {
+                ++numFailures;
+                std::printf("FAIL %.0f Hz bank block %d: %s\n", sampleRate, blockSize, problem.c_str());
+            } else if (verbose) {
+                std::printf("  bank block %d: every instance bit-identical\n", blockSize);
+            }
+        }
+    }
+
+    {
+        const std::string problem = checkStalledWorker();
+        ++numCases;
+
+        if (! problem.empty()) {
+            ++numFailures;
+            std::printf("FAIL stalled pipeline job: %s\n", problem.c_str());
+        } else if (verbose) {
+            std::printf("  stalled pipeline job: waited out\n");
+        }
+    }
+
+    std::printf("%d cases, %d outside tolerance\n", numCases, numFailures);
+    return numFailures == 0 ? 0 : 1;
+}
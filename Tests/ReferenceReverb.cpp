@@ -0,0 +1,138 @@
+/*
+  ==============================================================================
+
+    ReferenceReverb.cpp
+
+  ==============================================================================
+*/
+
+#include "ReferenceReverb.h"
+
+#include <cstring>
+
+//==============================================================================
+ReferenceReverb::ReferenceReverb()
+{
+    /* these delay times and gains are recommended for the 7-tap reverb in
+       [1] J. A. Moorer, "About This Reverberation Business," Computer Music Journal,
+           vol. 3, no. 2, pp. 13-28 (1979 Jun.). https://doi.org/10.2307/3680280.
+     */
+
+    // 0.0199, 0.0354, 0.0389, 0.0414, 0.0699, 0.0796 w/ compensation for predelay
+    const float firLengths[6] = { 0.0f, 0.0155f, 0.019f,
+                                  0.0215f, 0.05f, 0.0597f };
+    memcpy(firDelayLengths, firLengths, sizeof(firLengths));
+    const float firGains[6] = { 0.921f,  0.818f, 0.635f,
+                                0.719f, 0.267f, 0.242f };
+    memcpy(firCoefficients, firGains, sizeof(firGains));
+
+
+    // Moorer, 1965: 0.03, 0.034, 0.037, 0.041
+    const float iirLengths[6] = { 0.05f,  0.056f, 0.061f,
+                                  0.068f, 0.072f, 0.078f };
+    memcpy(iirDelayLengths, iirLengths, sizeof(iirLengths));
+    // damping is 0-1.8 to map these values to 0-0.99
+    const float iirGains[6] = { 0.46f, 0.48f, 0.5f, 0.52f, 0.53f, 0.55f };
+    memcpy(iirCoefficients, iirGains, sizeof(iirGains));
+
+    delayWrite = 0;
+}
+
+void ReferenceReverb::prepare(double sampleRate)
+{
+    currentSampleRate = sampleRate;
+
+    /* init delay buffers */
+    delayBufferLength = (int)(0.2*sampleRate); // max delay 200 ms
+
+    for (auto* buffers : { inputDelayBuffer, firDelayBuffer, combDelayBuffer, allpassDelayBuffers })
+        for (int channel = 0; channel < 2; ++channel)
+            buffers[channel].assign((size_t)delayBufferLength, 0.0f);
+
+    for (auto& buffer : combDelayBuffers)
+        buffer.assign((size_t)delayBufferLength, 0.0f);
+
+    delayWrite = 0;
+}
+
+void ReferenceReverb::process(float* const* channels, int totalNumInputChannels, int numSamples)
+{
+    const int sampleRate = (int)currentSampleRate;
+    int dpr, dpw = delayWrite;
+
+
+    for (int channel = 0; channel < totalNumInputChannels && channel < 2; ++channel) {
+        auto* channelData = channels[channel];
+        auto* inputDelayData = inputDelayBuffer[channel].data();
+        auto* firDelayData = firDelayBuffer[channel].data();
+        auto* combDelayData = combDelayBuffer[channel].data();
+        auto* allpassDelayData1 = allpassDelayBuffers[channel].data();
+
+        dpw = delayWrite;
+
+        for (int sample = 0; sample < numSamples; ++sample) {
+            const float in = channelData[sample];
+            float out = 0.0f;
+            inputDelayData[dpw] = in;
+            firDelayData[dpw] = in;
+
+
+            /* FIR DELAY TAPS */
+            for (int i = 0; i < 6; i++) {
+                dpr = (int)(dpw - ((predelay1)+firDelayLengths[i])*sampleRate + 2*delayBufferLength) % delayBufferLength;
+                float tap = firCoefficients[i] * inputDelayData[dpr];
+                firDelayData[dpw] += tap;
+            }
+            /* ============== */
+
+
+            /* PARALLEL IIR COMB FILTERS */
+            float combSum = 0.0f;
+            for (int i = 0; i < 6; i++) {
+                float* currentComb = combDelayBuffers[channel + 2*i].data();
+                iirCombFilter(currentComb, firDelayData, dpw, iirDelayLengths[i], (damping)*iirCoefficients[i]);
+                combSum += currentComb[dpw];
+            }
+            combDelayData[dpw] = combSum;
+            /* ========================= */
+
+
+            /* ALLPASS SECTION */
+            allpassFilter(allpassDelayData1, combDelayData, dpw, 0.006f);
+            /* =============== */
+
+
+            /* this delay lines up first late reflection with the last early reflection (as recommended in [1]) */
+            dpr = (int)(dpw - (0.029f+(predelay1))*sampleRate + delayBufferLength) % delayBufferLength;
+            out = 0.15f*(firDelayData[dpw] + allpassDelayData1[dpr]);
+            channelData[sample] = (1.0f-(wetMix))*in + (wetMix)*out;
+
+
+            dpw = (dpw + 1) % delayBufferLength;
+        }
+    }
+
+    delayWrite = dpw;
+}
+
+void ReferenceReverb::iirCombFilter(float* output, float* input, int writePtr, float delay, float feedback)
+{
+    // y[n] = x[n-d] + g*y[n-d]
+    int dpr = (int)(writePtr - delay*currentSampleRate + delayBufferLength) % delayBufferLength;
+    float xd = input[dpr];  // delayed input
+    float fb = output[dpr]; // previous output
+
+    // lowpass feedback line: y[n] = (1-g)*(x[n] + g*x[n-1])
+    dpr = (int)(dpr - 1 + delayBufferLength) % delayBufferLength;
+    float fblp = (1-feedback)*(fb + feedback*(output[dpr]));
+
+    // uses comb output to dictate reverb time
+    output[writePtr] = (reverbTime)*(xd + fblp);
+}
+
+void ReferenceReverb::allpassFilter(float* output, float* input, int writePtr, float delay)
+{
+    // y[n] = -g*x[n] + x[n-d] + g*y[n-d]
+    int dpr = (int)(writePtr - delay*currentSampleRate + delayBufferLength) % delayBufferLength;
+    output[writePtr] = -0.7*input[writePtr] + input[dpr] + 0.7*output[dpr];
+}
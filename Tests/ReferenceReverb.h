@@ -0,0 +1,46 @@
+/*
+  ==============================================================================
+
+    ReferenceReverb.h
+
+    The original per-sample processBlock, iirCombFilter and allpassFilter,
+    frozen as they were before the block engine, with JUCE's buffers swapped
+    for plain vectors and the parameters as plain floats. Every optimised
+    engine is nulled against this. Don't change the arithmetic here: it is
+    the definition of how the reverb sounds.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <vector>
+
+class ReferenceReverb
+{
+public:
+    ReferenceReverb();
+
+    /* one or two channels, like the original buses */
+    void prepare(double sampleRate);
+
+    float reverbTime {0.875f}, predelay1 {0.02f}, damping {0.7f}, wetMix {1.0f};
+
+    void process(float* const* channels, int numChannels, int numSamples);
+
+private:
+    std::vector<float> inputDelayBuffer[2], firDelayBuffer[2], combDelayBuffers[12],
+                       combDelayBuffer[2], allpassDelayBuffers[2];
+
+    double currentSampleRate {44100.0};
+    int delayBufferLength {1};
+    int delayWrite {0};
+
+    float iirDelayLengths[6];
+    float iirCoefficients[6];
+    float firDelayLengths[6];
+    float firCoefficients[6];
+
+    void iirCombFilter(float* output, float* input, int writePtr, float delay, float feedback);
+    void allpassFilter(float* output, float* input, int writePtr, float delay);
+};
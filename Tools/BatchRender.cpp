@@ -0,0 +1,766 @@
+/*
+  ==============================================================================
+
+    BatchRender.cpp
+
+    Renders WAV files through the reverb offline, without a host. Each input
+    is rendered once per parameter set, to its length plus the tail the
+    engine reports for those parameters, through a MoorerReverbSwitcher
+    driven exactly as MoorerReverbAudioProcessor drives it: scalar combs,
+    reserved, prepared with the set, then the parameters and one process()
+    call per host block, with denormals flushed. So at the same block size
+    and parameter values the output is bit-identical to the plugin's.
+
+    Every render is one task, unless --segment splits it into stretches of
+    that many seconds so one long file can use every core. The combs carry
+    state from one stretch to the next, so each segment's engine starts
+    early and runs in over a warm-up long enough for the reverb of whatever
+    came before to have decayed by --segment-error dB (-120 by default);
+    its output up to the segment is thrown away. Segments start on the
+    serial render's block grid and eco decimation phase, so the only
+    difference is the ringing the warm-up leaves out, and --verify renders
+    each split file again in one piece and reports (and fails on) how far
+    it strays, in dB below its peak.
+
+    The tasks are dealt largest first onto one queue per thread; a thread
+    works through its own queue and, once that's empty, steals the smallest
+    task left on another's, so a few long ones don't leave the rest of the
+    threads idle at the end. The segments write straight into their stretch
+    of the output file.
+
+    With --checkpoint, a render saves where it's got to every that many
+    seconds, to <output>.checkpoint next to its output: the engine's whole
+    state from saveState(), after the frames before it are on disk. Run the
+    same command again with --resume and a render that has a checkpoint
+    reopens its output and carries on from there, and its output comes out
+    bit-identical to an uninterrupted render's; one without starts afresh.
+    The checkpoint records the block size, precision, set and input it was
+    made with, and isn't used for any other. It's deleted once the render
+    is done. Both render each file in one piece, so neither goes with
+    --segment.
+
+    A parameter set is a comma-separated list of the plugin's parameter IDs
+    and values, in the plugin's units, optionally named:
+        --set hall:reverbtime=0.93,predelay1=0.035,damping=0.5,wetmix=0.4,topology=dense
+    topology takes moorer, schroeder or dense, eco takes off, 2x or 4x (or
+    their indices, as in saved state), and multicore takes 0 or 1. Anything
+    left out keeps the plugin's default. Renders are written as 32-bit float
+    WAV (64-bit with --double) to <output>/<name>.<set>.wav, or
+    <name>.reverb.wav when there's one unnamed set.
+
+    moorer_render [--set <set>]... [--block <n>] [--threads <n>] [--double] [--output <dir>]
+                  [--segment <s> [--segment-error <dB>] [--verify] | [--checkpoint <s>] [--resume]]
+                  <input.wav>...
+
+  ==============================================================================
+*/
+
+#include "DSP/MoorerReverbSwitcher.h"
+#include "WavFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE__) || defined(_M_X64)
+ #include <xmmintrin.h>
+#endif
+
+namespace
+{
+    // as the plugin reserves for and accepts (MOORER_MAX_SAMPLE_RATE, MOORER_MAX_CHANNELS)
+    constexpr double maxSampleRate = 96000.0;
+    constexpr int maxChannels = 16;
+
+    using Clock = std::chrono::steady_clock;
+
+    /* what juce::ScopedNoDenormals does around every processBlock */
+    class ScopedNoDenormals
+    {
+    public:
+       #if defined(__SSE__) || defined(_M_X64)
+        ScopedNoDenormals() : mode(_mm_getcsr()) { _mm_setcsr(mode | 0x8040); }
+        ~ScopedNoDenormals() { _mm_setcsr(mode); }
+       #elif defined(__aarch64__)
+        ScopedNoDenormals()
+        {
+            asm volatile("mrs %0, fpcr" : "=r"(mode));
+            asm volatile("msr fpcr, %0" : : "r"(mode | (1 << 24)));
+        }
+        ~ScopedNoDenormals() { asm volatile("msr fpcr, %0" : : "r"(mode)); }
+       #endif
+
+    private:
+        std::uint64_t mode {0};
+    };
+
+    //==============================================================================
+    struct ParameterSet
+    {
+        std::string name;
+        MoorerReverbParameters parameters;
+        MoorerReverbSwitcher<float>::Configuration configuration;
+    };
+
+    /* one of the plugin's float parameters: its ID, range and where it goes */
+    struct FloatParameter
+    {
+        const char* id;
+        float minimum, maximum;
+        float MoorerReverbParameters::* field;
+    };
+
+    const FloatParameter floatParameters[] = {
+        { "reverbtime", 0.5f,    1.0f, &MoorerReverbParameters::reverbTime },
+        { "predelay1",  0.0005f, 0.1f, &MoorerReverbParameters::predelay },
+        { "damping",    0.0f,    1.8f, &MoorerReverbParameters::damping },
+        { "wetmix",     0.0f,    1.0f, &MoorerReverbParameters::wetMix },
+    };
+
+    bool parseNumber(const std::string& text, double& value)
+    {
+        char* end = nullptr;
+        value = std::strtod(text.c_str(), &end);
+        return ! text.empty() && end == text.c_str() + text.size();
+    }
+
+    /* a choice parameter by name, or by index as saved state has it */
+    bool parseChoice(const std::string& text, const std::vector<const char*>& names, int& index)
+    {
+        for (index = 0; index < (int)names.size(); ++index)
+            if (text == names[(size_t)index])
+                return true;
+
+        double value;
+        index = parseNumber(text, value) ? (int)value : -1;
+        return index >= 0 && index < (int)names.size() && value == (double)index;
+    }
+
+    bool parseSet(const std::string& text, int number, ParameterSet& set, std::string& error)
+    {
+        std::string rest = text;
+        const auto colon = text.find(':');
+        if (colon != std::string::npos && colon < text.find('=')) {
+            set.name = text.substr(0, colon);
+            rest = text.substr(colon + 1);
+        } else {
+            set.name = "set" + std::to_string(number);
+        }
+
+        for (size_t start = 0; start < rest.size(); ) {
+            const size_t comma = std::min(rest.find(',', start), rest.size());
+            const std::string item = rest.substr(start, comma - start);
+            start = comma + 1;
+
+            const auto equals = item.find('=');
+            const std::string id = item.substr(0, equals), value = equals == std::string::npos ? "" : item.substr(equals + 1);
+            int index;
+            double amount;
+
+            const auto* parameter = std::find_if(std::begin(floatParameters), std::end(floatParameters),
+                                                 [&id](const FloatParameter& p) { return id == p.id; });
+            if (parameter != std::end(floatParameters)) {
+                if (! parseNumber(value, amount) || amount < parameter->minimum || amount > parameter->maximum) {
+                    error = id + " takes a number from " + std::to_string(parameter->minimum)
+                          + " to " + std::to_string(parameter->maximum);
+                    return false;
+                }
+                set.parameters.*parameter->field = (float)amount;
+            } else if (id == "topology") {
+                if (! parseChoice(value, { "moorer", "schroeder", "dense" }, index)) {
+                    error = "topology takes moorer, schroeder or dense";
+                    return false;
+                }
+                set.configuration.topology = (TopologyPreset)index;
+            } else if (id == "eco") {
+                if (! parseChoice(value, { "off", "2x", "4x" }, index)) {
+                    error = "eco takes off, 2x or 4x";
+                    return false;
+                }
+                set.configuration.decimation = 1 << index;
+            } else if (id == "multicore") {
+                if (! parseChoice(value, { "0", "1" }, index)) {
+                    error = "multicore takes 0 or 1";
+                    return false;
+                }
+                set.configuration.pipelined = index == 1;
+            } else {
+                error = "no parameter called '" + id + "'";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //==============================================================================
+    struct Options
+    {
+        int blockSize {512};
+        bool doublePrecision {false};
+        std::string outputDirectory;
+        double segmentSeconds {0.0};               // 0 renders each file in one piece
+        double segmentErrorDecibels {-120.0};
+        bool verify {false};
+        double checkpointSeconds {0.0};            // 0 never saves one
+        bool resume {false};
+    };
+
+    /* one output file: an input through one set, in one or more segments */
+    struct Render
+    {
+        std::string input, output;
+        const ParameterSet* set {nullptr};
+        WavReader reader;
+        WavWriter writer;
+        std::int64_t numFrames {0};                // the input and its tail
+        std::int64_t warmUpFrames {0};
+        int numSegments {0};
+
+        // unsegmented renders only
+        std::string checkpoint;
+        std::int64_t checkpointFrames {0};         // on the block grid, 0 for none
+        std::int64_t resumeFrame {0};
+        std::vector<unsigned char> resumeState;
+
+        // under the progress lock
+        int segmentsLeft {0};
+        bool started {false};
+        Clock::time_point startTime;
+        double wallSeconds {0.0}, busySeconds {0.0};
+        std::string error;
+    };
+
+    /* a stretch of a render that's one task: its engine starts at warmUpFrom
+       and runs in until first, and first up to last is written */
+    struct Segment
+    {
+        Render* render;
+        std::int64_t warmUpFrom, first, last;
+    };
+
+    /* everything a checkpoint is only good for: the input, how it's rendered and the set */
+    std::string describe(const Render& job, const Options& options)
+    {
+        char text[512];
+        const auto& configuration = job.set->configuration;
+        std::snprintf(text, sizeof(text), "%s %lld %d %.17g block %d %s topology %d eco %d multicore %d",
+                      job.input.c_str(), (long long)job.reader.getNumFrames(), job.reader.getNumChannels(),
+                      job.reader.getSampleRate(), options.blockSize, options.doublePrecision ? "double" : "float",
+                      (int)configuration.topology, configuration.decimation, configuration.pipelined ? 1 : 0);
+
+        std::string description(text);
+        for (const auto& parameter : floatParameters) {
+            std::snprintf(text, sizeof(text), " %s %.9g", parameter.id, (double)(job.set->parameters.*parameter.field));
+            description += text;
+        }
+        return description;
+    }
+
+    /* a checkpoint is "MRCK", a version, the length and text of describe(),
+       the frame to carry on from and then the engine's state, all in the
+       machine's own byte order */
+    constexpr char checkpointMagic[4] = { 'M', 'R', 'C', 'K' };
+    constexpr std::uint32_t checkpointVersion = 1;
+
+    /* fills in job's resume point from its checkpoint, if it has one */
+    bool readCheckpoint(Render& job, const Options& options)
+    {
+        FILE* file = std::fopen(job.checkpoint.c_str(), "rb");
+        if (file == nullptr)
+            return true;
+
+        std::vector<unsigned char> bytes;
+        unsigned char block[1 << 16];
+        for (size_t count; (count = std::fread(block, 1, sizeof(block), file)) > 0; )
+            bytes.insert(bytes.end(), block, block + count);
+        std::fclose(file);
+
+        const std::string description = describe(job, options);
+        std::uint32_t version = 0, length = 0;
+        std::int64_t frame = 0;
+        const size_t stateOffset = 12 + description.size() + sizeof(frame);
+        if (bytes.size() >= 12) {
+            std::memcpy(&version, bytes.data() + 4, 4);
+            std::memcpy(&length, bytes.data() + 8, 4);
+        }
+        if (bytes.size() < stateOffset || std::memcmp(bytes.data(), checkpointMagic, 4) != 0
+             || version != checkpointVersion || length != description.size()) {
+            job.error = job.checkpoint + " isn't a checkpoint this version can resume";
+            return false;
+        }
+        if (std::memcmp(bytes.data() + 12, description.data(), description.size()) != 0) {
+            job.error = job.checkpoint + " is from a different input, set, block size or precision";
+            return false;
+        }
+
+        std::memcpy(&frame, bytes.data() + 12 + description.size(), sizeof(frame));
+        if (frame <= 0 || frame >= job.numFrames || frame % options.blockSize != 0) {
+            job.error = job.checkpoint + " doesn't fall inside the render";
+            return false;
+        }
+        job.resumeFrame = frame;
+        job.resumeState.assign(bytes.begin() + (std::ptrdiff_t)stateOffset, bytes.end());
+        return true;
+    }
+
+    /* saves job's checkpoint at frame, once the output before it is on disk;
+       it's written to one side and renamed into place, so a render that stops
+       partway through leaves the last one whole */
+    bool writeCheckpoint(Render& job, const Options& options, std::int64_t frame, const std::vector<unsigned char>& state)
+    {
+        if (! job.writer.sync())
+            return false;
+
+        const std::string description = describe(job, options);
+        const std::uint32_t length = (std::uint32_t)description.size();
+        std::vector<unsigned char> bytes(checkpointMagic, checkpointMagic + 4);
+        auto put = [&bytes](const void* data, size_t size) {
+            bytes.insert(bytes.end(), (const unsigned char*)data, (const unsigned char*)data + size);
+        };
+        put(&checkpointVersion, 4);
+        put(&length, 4);
+        put(description.data(), description.size());
+        put(&frame, sizeof(frame));
+        put(state.data(), state.size());
+
+        const std::string temporary = job.checkpoint + ".partial";
+        const int descriptor = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (descriptor < 0)
+            return false;
+        const bool written = ::write(descriptor, bytes.data(), bytes.size()) == (ssize_t)bytes.size()
+                          && fsync(descriptor) == 0;
+        ::close(descriptor);
+        return written && std::rename(temporary.c_str(), job.checkpoint.c_str()) == 0;
+    }
+
+    /* opens the input and output and works out how long the render is */
+    bool plan(Render& job, const Options& options)
+    {
+        if (! job.reader.open(job.input, job.error))
+            return false;
+
+        const int numChannels = job.reader.getNumChannels();
+        if (numChannels > maxChannels) {
+            job.error = job.input + " has more channels than the plugin takes (" + std::to_string(maxChannels) + ")";
+            return false;
+        }
+
+        const ParameterSet& set = *job.set;
+        const double sampleRate = job.reader.getSampleRate();
+        double tail = 0.0, warmUp = 0.0;
+        withTopology(set.configuration.topology, [&](auto chosen) {
+            using Engine = BasicMoorerReverbEngine<float, decltype(chosen)>;
+            tail = Engine::getTailLengthSeconds(set.parameters);
+            warmUp = Engine::getTailLengthSeconds(set.parameters, options.segmentErrorDecibels);
+        });
+        if (! std::isfinite(tail)) {
+            job.error = "set " + set.name + " never decays";
+            return false;
+        }
+        job.numFrames = job.reader.getNumFrames() + (std::int64_t)std::ceil(tail*sampleRate);
+        job.warmUpFrames = (std::int64_t)std::ceil(warmUp*sampleRate);
+
+        job.checkpoint = job.output + ".checkpoint";
+        if (options.checkpointSeconds > 0.0) {
+            const std::int64_t blocks = (std::int64_t)std::ceil(options.checkpointSeconds*sampleRate/options.blockSize);
+            job.checkpointFrames = std::max<std::int64_t>(1, blocks)*options.blockSize;
+        }
+        if (options.resume && ! readCheckpoint(job, options))
+            return false;
+
+        const int bitsPerSample = options.doublePrecision ? 64 : 32;
+        if (job.resumeFrame > 0)
+            return job.writer.reopen(job.output, sampleRate, numChannels, bitsPerSample, job.numFrames, job.error);
+        return job.writer.open(job.output, sampleRate, numChannels, bitsPerSample, job.numFrames, job.error);
+    }
+
+    /* runs an engine for job from frame from up to frame to, set up and
+       driven as MoorerReverbAudioProcessor does, and hands output() every
+       block from keepFrom (which must be on the block grid) on. With
+       checkpoints, it starts from job's resume point instead and saves a
+       checkpoint at every multiple of job.checkpointFrames */
+    template <typename SampleType, typename Output>
+    bool renderFrames(Render& job, const Options& options, std::int64_t from, std::int64_t keepFrom,
+                      std::int64_t to, Output&& output, bool checkpoints = false)
+    {
+        ScopedNoDenormals noDenormals;
+        const ParameterSet& set = *job.set;
+        const int numChannels = job.reader.getNumChannels();
+
+        // as its constructor and prepareToPlay() set it up
+        const typename MoorerReverbSwitcher<SampleType>::Configuration configuration {
+            set.configuration.topology, set.configuration.decimation, set.configuration.pipelined
+        };
+        MoorerReverbSwitcher<SampleType> engine;
+        engine.setCombEngine(MoorerReverbEngineBase::CombEngine::scalar);
+        engine.reserve(configuration, maxSampleRate, std::max(2, numChannels));
+        engine.prepare(configuration, job.reader.getSampleRate(), numChannels, options.blockSize, set.parameters);
+
+        std::vector<unsigned char> state;
+        if (checkpoints && job.resumeFrame > 0) {
+            if (! engine.restoreState(job.resumeState.data(), job.resumeState.size())) {
+                job.error = job.checkpoint + " was saved by an engine this one can't carry on from";
+                return false;
+            }
+            from = keepFrom = job.resumeFrame;
+        }
+
+        std::vector<SampleType> samples((size_t)(numChannels*options.blockSize));
+        std::vector<SampleType*> channels((size_t)numChannels);
+        for (int channel = 0; channel < numChannels; ++channel)
+            channels[(size_t)channel] = samples.data() + channel*options.blockSize;
+
+        // and as its processBlock() runs each block
+        for (std::int64_t done = from; done < to; done += options.blockSize) {
+            const int count = (int)std::min<std::int64_t>(options.blockSize, to - done);
+            job.reader.read(done, count, channels.data());
+            engine.requestConfiguration(configuration);
+            engine.setParameters(set.parameters);
+            engine.process(channels.data(), numChannels, count);
+            if (done >= keepFrom && ! output(done, channels.data(), count))
+                return false;
+
+            // a checkpoint that can't be saved costs a longer re-render, not this one
+            const std::int64_t next = done + count;
+            if (checkpoints && job.checkpointFrames > 0 && next % job.checkpointFrames == 0 && next < to
+                 && ! (engine.saveState(state) && writeCheckpoint(job, options, next, state)))
+                std::fprintf(stderr, "%s: can't save a checkpoint at %.2f s\n", job.checkpoint.c_str(),
+                             (double)next/job.reader.getSampleRate());
+        }
+        return true;
+    }
+
+    /* renders job again in one piece and returns how far its segmented
+       output strays from that, in dB below the serial render's peak */
+    template <typename SampleType>
+    double measureSegmentError(Render& job, const Options& options, std::string& error)
+    {
+        WavReader written;
+        if (! written.open(job.output, error))
+            return 0.0;
+
+        std::vector<SampleType> samples((size_t)(job.reader.getNumChannels()*options.blockSize));
+        std::vector<SampleType*> channels((size_t)job.reader.getNumChannels());
+        for (size_t channel = 0; channel < channels.size(); ++channel)
+            channels[channel] = samples.data() + channel*(size_t)options.blockSize;
+
+        // the float output holds the float engine's samples exactly, and the double output the double's
+        double maxError = 0.0, peak = 0.0;
+        renderFrames<SampleType>(job, options, 0, 0, job.numFrames,
+                                 [&](std::int64_t frame, SampleType* const* serial, int count) {
+            written.read(frame, count, channels.data());
+            for (size_t channel = 0; channel < channels.size(); ++channel) {
+                for (int i = 0; i < count; ++i) {
+                    maxError = std::max(maxError, (double)std::abs(channels[channel][i] - serial[channel][i]));
+                    peak = std::max(peak, (double)std::abs(serial[channel][i]));
+                }
+            }
+            return true;
+        });
+
+        if (maxError == 0.0)
+            return -std::numeric_limits<double>::infinity();
+        return 20.0*std::log10(maxError/std::max(peak, 1.0e-30));
+    }
+
+    //==============================================================================
+    /* runs every task on numThreads threads, each working through its own
+       queue front first and then stealing from the backs of the others */
+    void runStealing(std::vector<std::function<void()>>& tasks, int numThreads)
+    {
+        struct Queue
+        {
+            std::mutex lock;
+            std::deque<std::function<void()>*> tasks;
+        };
+        std::vector<Queue> queues((size_t)numThreads);
+        for (size_t i = 0; i < tasks.size(); ++i)
+            queues[i % (size_t)numThreads].tasks.push_back(&tasks[i]);
+
+        auto take = [&queues](size_t queue, bool own) -> std::function<void()>* {
+            std::lock_guard<std::mutex> hold(queues[queue].lock);
+            auto& waiting = queues[queue].tasks;
+            if (waiting.empty())
+                return nullptr;
+            std::function<void()>* task;
+            if (own) {
+                task = waiting.front();
+                waiting.pop_front();
+            } else {
+                task = waiting.back();
+                waiting.pop_back();
+            }
+            return task;
+        };
+
+        // no task is queued once they're all dealt, so an empty sweep means the thread is done
+        auto work = [&](size_t self) {
+            for (;;) {
+                auto* task = take(self, true);
+                for (size_t other = 1; task == nullptr && other < queues.size(); ++other)
+                    task = take((self + other) % queues.size(), false);
+                if (task == nullptr)
+                    return;
+                (*task)();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int i = 1; i < numThreads; ++i)
+            threads.emplace_back(work, (size_t)i);
+        work(0);
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    std::string stem(const std::string& path)
+    {
+        const auto slash = path.find_last_of('/');
+        std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+        const auto dot = name.find_last_of('.');
+        return dot == std::string::npos || dot == 0 ? name : name.substr(0, dot);
+    }
+
+    std::string directory(const std::string& path)
+    {
+        const auto slash = path.find_last_of('/');
+        return slash == std::string::npos ? "." : path.substr(0, slash);
+    }
+
+    /* like mkdir -p */
+    bool makeDirectories(const std::string& path)
+    {
+        for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+            const std::string prefix = path.substr(0, slash);
+            if (mkdir(prefix.c_str(), 0777) != 0 && errno != EEXIST)
+                return false;
+            if (slash == std::string::npos)
+                return true;
+        }
+    }
+
+    void usage(const char* program)
+    {
+        std::fprintf(stderr, "usage: %s [--set [name:]id=value,...]... [--block <n>] [--threads <n>] [--double]\n"
+                             "       [--output <dir>] [--segment <s> [--segment-error <dB>] [--verify] | [--checkpoint <s>] [--resume]]\n"
+                             "       <input.wav>...\n",
+                     program);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    int numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    std::vector<ParameterSet> sets;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--set") == 0 && i + 1 < argc) {
+            std::string error;
+            sets.emplace_back();
+            if (! parseSet(argv[++i], (int)sets.size(), sets.back(), error)) {
+                std::fprintf(stderr, "--set %s: %s\n", argv[i], error.c_str());
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--block") == 0 && i + 1 < argc) {
+            options.blockSize = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            numThreads = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--double") == 0) {
+            options.doublePrecision = true;
+        } else if ((std::strcmp(argv[i], "--output") == 0 || std::strcmp(argv[i], "-o") == 0) && i + 1 < argc) {
+            options.outputDirectory = argv[++i];
+        } else if (std::strcmp(argv[i], "--segment") == 0 && i + 1 < argc) {
+            options.segmentSeconds = std::max(0.0, std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--segment-error") == 0 && i + 1 < argc) {
+            options.segmentErrorDecibels = std::min(-1.0, std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--verify") == 0) {
+            options.verify = true;
+        } else if (std::strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            options.checkpointSeconds = std::max(0.0, std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--resume") == 0) {
+            options.resume = true;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    if (inputs.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (options.segmentSeconds > 0.0 && (options.checkpointSeconds > 0.0 || options.resume)) {
+        std::fprintf(stderr, "--checkpoint and --resume render each file in one piece, so can't go with --segment\n");
+        return 1;
+    }
+
+    const bool unnamed = sets.empty();
+    if (unnamed)
+        sets.emplace_back();
+
+    while (options.outputDirectory.size() > 1 && options.outputDirectory.back() == '/')
+        options.outputDirectory.pop_back();
+    if (! options.outputDirectory.empty() && ! makeDirectories(options.outputDirectory)) {
+        std::fprintf(stderr, "can't create %s\n", options.outputDirectory.c_str());
+        return 1;
+    }
+
+    int numFailed = 0;
+    std::vector<std::unique_ptr<Render>> renders;
+    std::vector<Segment> segments;
+    for (const auto& input : inputs) {
+        for (const auto& set : sets) {
+            auto job = std::make_unique<Render>();
+            job->input = input;
+            job->set = &set;
+            job->output = (options.outputDirectory.empty() ? directory(input) : options.outputDirectory)
+                        + "/" + stem(input) + "." + (unnamed ? std::string("reverb") : set.name) + ".wav";
+            if (! plan(*job, options)) {
+                std::fprintf(stderr, "%s\n", job->error.c_str());
+                ++numFailed;
+                continue;
+            }
+
+            /* segments start on multiples of maxDecimation blocks, so each one's
+               blocks and eco decimation phase line up with a serial render's */
+            const std::int64_t alignment = (std::int64_t)options.blockSize*MoorerReverbEngineBase::maxDecimation;
+            auto alignUp = [alignment](std::int64_t frames) { return (frames + alignment - 1)/alignment*alignment; };
+            const std::int64_t segmentFrames = options.segmentSeconds > 0.0
+                ? std::max(alignment, alignUp((std::int64_t)(options.segmentSeconds*job->reader.getSampleRate())))
+                : job->numFrames;
+            const std::int64_t warmUpFrames = alignUp(job->warmUpFrames);
+            for (std::int64_t first = 0; first < job->numFrames; first += segmentFrames) {
+                segments.push_back({ job.get(), std::max<std::int64_t>(0, first - warmUpFrames), first,
+                                     std::min(job->numFrames, first + segmentFrames) });
+                ++job->numSegments;
+            }
+            job->segmentsLeft = job->numSegments;
+            renders.push_back(std::move(job));
+        }
+    }
+
+    // largest first, so the long renders start early and the short ones fill in round them
+    auto cost = [](const Segment& s) { return (s.last - s.warmUpFrom)*s.render->reader.getNumChannels(); };
+    std::stable_sort(segments.begin(), segments.end(), [&cost](const Segment& a, const Segment& b) {
+        return cost(a) > cost(b);
+    });
+
+    numThreads = std::max(1, std::min(numThreads, (int)segments.size()));
+    std::printf("%d render%s in %d segment%s, %d-sample blocks, %s, %d thread%s\n",
+                (int)renders.size(), renders.size() == 1 ? "" : "s", (int)segments.size(), segments.size() == 1 ? "" : "s",
+                options.blockSize, options.doublePrecision ? "double" : "float", numThreads, numThreads == 1 ? "" : "s");
+
+    std::mutex progressLock;
+    std::vector<std::function<void()>> tasks;
+    for (const auto& segment : segments) {
+        tasks.push_back([&segment, &options, &progressLock, &numFailed] {
+            Render& job = *segment.render;
+            const auto start = Clock::now();
+            {
+                std::lock_guard<std::mutex> hold(progressLock);
+                if (! job.started) {
+                    job.started = true;
+                    job.startTime = start;
+                }
+            }
+
+            auto write = [&job](std::int64_t frame, auto* const* channels, int count) {
+                return job.writer.write(frame, channels, count);
+            };
+            const bool checkpoints = job.numSegments == 1;
+            if (options.doublePrecision)
+                renderFrames<double>(job, options, segment.warmUpFrom, segment.first, segment.last, write, checkpoints);
+            else
+                renderFrames<float>(job, options, segment.warmUpFrom, segment.first, segment.last, write, checkpoints);
+
+            std::lock_guard<std::mutex> hold(progressLock);
+            const auto end = Clock::now();
+            job.busySeconds += std::chrono::duration<double>(end - start).count();
+            if (--job.segmentsLeft > 0)
+                return;
+
+            job.wallSeconds = std::chrono::duration<double>(end - job.startTime).count();
+            const double seconds = (double)(job.numFrames - job.resumeFrame)/job.reader.getSampleRate();
+            if (job.error.empty() && job.writer.close(job.error)) {
+                std::remove(job.checkpoint.c_str());
+                std::printf("%-40s %9.2f s %9.1f ms %8.1fx realtime", job.output.c_str(),
+                            seconds, 1000.0*job.wallSeconds, seconds/std::max(job.wallSeconds, 1.0e-9));
+                if (job.numSegments > 1)
+                    std::printf(" (%d segments, %.2f s warm-up)", job.numSegments,
+                                (double)job.warmUpFrames/job.reader.getSampleRate());
+                if (job.resumeFrame > 0)
+                    std::printf(" (resumed at %.2f s)", (double)job.resumeFrame/job.reader.getSampleRate());
+                std::printf("\n");
+            } else {
+                std::fprintf(stderr, "%s\n", job.error.c_str());
+                ++numFailed;
+            }
+            std::fflush(stdout);
+        });
+    }
+
+    const auto start = Clock::now();
+    runStealing(tasks, numThreads);
+    const double wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    double seconds = 0.0, busySeconds = 0.0;
+    for (const auto& job : renders) {
+        seconds += (double)(job->numFrames - job->resumeFrame)/job->reader.getSampleRate();
+        busySeconds += job->busySeconds;
+    }
+    std::printf("%.2f s of audio in %.2f s: %.1fx realtime overall, %.1fx per thread\n",
+                seconds, wallSeconds, seconds/std::max(wallSeconds, 1.0e-9), seconds/std::max(busySeconds, 1.0e-9));
+
+    // each segmented render against a serial one, which is bit-identical to the plugin's
+    if (options.verify) {
+        tasks.clear();
+        for (const auto& render : renders) {
+            Render& job = *render;
+            if (job.numSegments < 2 || ! job.error.empty())
+                continue;
+
+            tasks.push_back([&job, &options, &progressLock, &numFailed] {
+                std::string error;
+                const double decibels = options.doublePrecision ? measureSegmentError<double>(job, options, error)
+                                                                : measureSegmentError<float>(job, options, error);
+
+                std::lock_guard<std::mutex> hold(progressLock);
+                if (! error.empty()) {
+                    std::fprintf(stderr, "%s\n", error.c_str());
+                    ++numFailed;
+                } else if (decibels > options.segmentErrorDecibels) {
+                    std::fprintf(stderr, "%s: %.1f dB from a serial render, over the %.1f dB bound\n",
+                                 job.output.c_str(), decibels, options.segmentErrorDecibels);
+                    ++numFailed;
+                } else {
+                    std::printf("%-40s %.1f dB from a serial render\n", job.output.c_str(), decibels);
+                }
+                std::fflush(stdout);
+            });
+        }
+        runStealing(tasks, std::max(1, std::min(numThreads, (int)tasks.size())));
+    }
+
+    return numFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,324 @@
+/*
+  ==============================================================================
+
+    WavFile.cpp
+
+  ==============================================================================
+*/
+
+#include "WavFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr int formatPcm = 1, formatFloat = 3, formatExtensible = 0xfffe;
+
+    // the tail of every WAVE_FORMAT_EXTENSIBLE subformat GUID; the first two bytes are the format tag
+    const unsigned char subformatTail[14] = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00,
+                                              0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71 };
+
+    std::uint32_t little32(const unsigned char* bytes)
+    {
+        return (std::uint32_t)bytes[0] | (std::uint32_t)bytes[1] << 8
+             | (std::uint32_t)bytes[2] << 16 | (std::uint32_t)bytes[3] << 24;
+    }
+
+    int little16(const unsigned char* bytes)
+    {
+        return bytes[0] | bytes[1] << 8;
+    }
+
+    void putLittle(std::vector<unsigned char>& bytes, std::uint64_t value, int size)
+    {
+        for (int i = 0; i < size; ++i)
+            bytes.push_back((unsigned char)(value >> (8*i)));
+    }
+
+    void putTag(std::vector<unsigned char>& bytes, const char* tag)
+    {
+        bytes.insert(bytes.end(), tag, tag + 4);
+    }
+}
+
+//==============================================================================
+WavReader::~WavReader()
+{
+    if (mapping != nullptr)
+        munmap((void*)mapping, mappingSize);
+}
+
+bool WavReader::open(const std::string& path, std::string& error)
+{
+    const int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        error = "can't open " + path;
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(descriptor, &status) != 0 || status.st_size < 12) {
+        ::close(descriptor);
+        error = path + " is too short to be a WAV file";
+        return false;
+    }
+
+    mappingSize = (std::size_t)status.st_size;
+    void* mapped = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    ::close(descriptor);
+    if (mapped == MAP_FAILED) {
+        error = "can't map " + path;
+        return false;
+    }
+    mapping = (const unsigned char*)mapped;
+    madvise(mapped, mappingSize, MADV_SEQUENTIAL);
+
+    if (std::memcmp(mapping, "RIFF", 4) != 0 || std::memcmp(mapping + 8, "WAVE", 4) != 0) {
+        error = path + " isn't a RIFF WAVE file";
+        return false;
+    }
+
+    int format = 0, bitsPerSample = 0;
+    std::size_t dataSize = 0;
+    const unsigned char* end = mapping + mappingSize;
+    for (const unsigned char* chunk = mapping + 12; chunk + 8 <= end; ) {
+        const std::size_t size = little32(chunk + 4);
+        const unsigned char* body = chunk + 8;
+        const std::size_t available = std::min(size, (std::size_t)(end - body));
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && available >= 16) {
+            format = little16(body);
+            numChannels = little16(body + 2);
+            sampleRate = (double)little32(body + 4);
+            bitsPerSample = little16(body + 14);
+            if (format == formatExtensible && available >= 40 && std::memcmp(body + 26, subformatTail, 14) == 0)
+                format = little16(body + 24);
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            data = body;
+            // a stream that was never finalised says 0 or more than there is; take what's there
+            dataSize = size == 0 ? (std::size_t)(end - body) : available;
+        }
+
+        // chunks are padded to an even size
+        if (size >= (std::size_t)(end - body))
+            break;
+        chunk = body + size + (size & 1);
+    }
+
+    if (data == nullptr || numChannels <= 0 || sampleRate <= 0.0) {
+        error = path + " has no audio in it";
+        return false;
+    }
+
+    bytesPerSample = bitsPerSample/8;
+    if (format == formatPcm && (bitsPerSample == 8 || bitsPerSample == 16 || bitsPerSample == 24 || bitsPerSample == 32)) {
+        encoding = bitsPerSample == 8 ? Encoding::unsignedInt : Encoding::signedInt;
+    } else if (format == formatFloat && (bitsPerSample == 32 || bitsPerSample == 64)) {
+        encoding = Encoding::floatingPoint;
+    } else {
+        error = path + ": only 8- to 32-bit integer and 32- or 64-bit float PCM can be read";
+        return false;
+    }
+
+    numFrames = (std::int64_t)(dataSize/((std::size_t)numChannels*(std::size_t)bytesPerSample));
+    return true;
+}
+
+double WavReader::sampleAt(const unsigned char* sample) const
+{
+    switch (encoding) {
+        case Encoding::unsignedInt:
+            return (double)((int)sample[0] - 128)*(1.0/128.0);
+
+        case Encoding::signedInt: {
+            // shifted up to the top of 32 bits, so every width sign-extends the same way
+            std::uint32_t bits = 0;
+            for (int i = 0; i < bytesPerSample; ++i)
+                bits |= (std::uint32_t)sample[i] << (8*(4 - bytesPerSample + i));
+            return (double)(std::int32_t)bits*(1.0/2147483648.0);
+        }
+
+        case Encoding::floatingPoint:
+            if (bytesPerSample == 4) {
+                float value;
+                std::memcpy(&value, sample, 4);
+                return (double)value;
+            } else {
+                double value;
+                std::memcpy(&value, sample, 8);
+                return value;
+            }
+    }
+    return 0.0;
+}
+
+template <typename SampleType>
+void WavReader::read(std::int64_t start, int count, SampleType* const* channels) const
+{
+    const int available = (int)std::max<std::int64_t>(0, std::min<std::int64_t>(count, numFrames - start));
+    const std::size_t frameBytes = (std::size_t)numChannels*(std::size_t)bytesPerSample;
+    for (int channel = 0; channel < numChannels; ++channel) {
+        const unsigned char* sample = data + (std::size_t)start*frameBytes + (std::size_t)(channel*bytesPerSample);
+        for (int i = 0; i < available; ++i, sample += frameBytes)
+            channels[channel][i] = (SampleType)sampleAt(sample);
+        std::fill(channels[channel] + available, channels[channel] + count, SampleType(0));
+    }
+}
+
+template void WavReader::read<float>(std::int64_t, int, float* const*) const;
+template void WavReader::read<double>(std::int64_t, int, double* const*) const;
+
+//==============================================================================
+WavWriter::~WavWriter()
+{
+    if (descriptor >= 0)
+        ::close(descriptor);
+}
+
+bool WavWriter::open(const std::string& newPath, double sampleRate, int newNumChannels, int newBitsPerSample,
+                     std::int64_t numFrames, std::string& error)
+{
+    return create(newPath, sampleRate, newNumChannels, newBitsPerSample, numFrames, false, error);
+}
+
+bool WavWriter::reopen(const std::string& newPath, double sampleRate, int newNumChannels, int newBitsPerSample,
+                       std::int64_t numFrames, std::string& error)
+{
+    return create(newPath, sampleRate, newNumChannels, newBitsPerSample, numFrames, true, error);
+}
+
+bool WavWriter::create(const std::string& newPath, double sampleRate, int newNumChannels, int newBitsPerSample,
+                       std::int64_t numFrames, bool keepFrames, std::string& error)
+{
+    path = newPath;
+    numChannels = newNumChannels;
+    bitsPerSample = newBitsPerSample;
+    failed = false;
+
+    // more than two channels need the extensible header; the channel mask is left unassigned
+    const bool extensible = numChannels > 2;
+    const int blockAlign = numChannels*bitsPerSample/8;
+    const std::uint64_t dataBytes = (std::uint64_t)numFrames*(std::uint64_t)blockAlign;
+    headerBytes = 40 + (extensible ? 40 : 16);   // RIFF, fact and data around the fmt chunk
+
+    // the RIFF sizes are 32 bits
+    if ((std::uint64_t)headerBytes + dataBytes > 0xffffffffull) {
+        error = path + " would be over 4 GB, more than a WAV file can hold";
+        return false;
+    }
+
+    std::vector<unsigned char> header;
+    putTag(header, "RIFF");
+    putLittle(header, (std::uint64_t)headerBytes + dataBytes - 8, 4);
+    putTag(header, "WAVE");
+    putTag(header, "fmt ");
+    putLittle(header, extensible ? 40 : 16, 4);
+    putLittle(header, extensible ? formatExtensible : formatFloat, 2);
+    putLittle(header, (std::uint64_t)numChannels, 2);
+    putLittle(header, (std::uint64_t)sampleRate, 4);
+    putLittle(header, (std::uint64_t)sampleRate*(std::uint64_t)blockAlign, 4);
+    putLittle(header, (std::uint64_t)blockAlign, 2);
+    putLittle(header, (std::uint64_t)bitsPerSample, 2);
+    if (extensible) {
+        putLittle(header, 22, 2);
+        putLittle(header, (std::uint64_t)bitsPerSample, 2);
+        putLittle(header, 0, 4);
+        putLittle(header, formatFloat, 2);
+        header.insert(header.end(), subformatTail, subformatTail + 14);
+    }
+    putTag(header, "fact");
+    putLittle(header, 4, 4);
+    putLittle(header, (std::uint64_t)numFrames, 4);
+    putTag(header, "data");
+    putLittle(header, dataBytes, 4);
+
+    const std::uint64_t fileBytes = (std::uint64_t)headerBytes + dataBytes;
+    if (keepFrames) {
+        // the header is written again, and has to come out the same as the one already there
+        std::vector<unsigned char> existing(header.size());
+        descriptor = ::open(path.c_str(), O_RDWR);
+        struct stat status;
+        if (descriptor < 0 || fstat(descriptor, &status) != 0 || (std::uint64_t)status.st_size != fileBytes
+             || pread(descriptor, existing.data(), existing.size(), 0) != (ssize_t)existing.size()
+             || existing != header) {
+            if (descriptor >= 0)
+                ::close(descriptor);
+            descriptor = -1;
+            error = "can't carry on " + path + ": it isn't the file this render started";
+            return false;
+        }
+        return true;
+    }
+
+    descriptor = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (descriptor < 0
+         || pwrite(descriptor, header.data(), header.size(), 0) != (ssize_t)header.size()
+         || ftruncate(descriptor, (off_t)fileBytes) != 0) {
+        error = "can't create " + path;
+        return false;
+    }
+    return true;
+}
+
+template <typename SampleType>
+bool WavWriter::write(std::int64_t start, const SampleType* const* channels, int numFrames)
+{
+    // a block at a time, so each write is a large one
+    unsigned char block[1 << 16];
+    const int frameBytes = numChannels*bitsPerSample/8;
+    const int framesPerBlock = (int)sizeof(block)/frameBytes;
+    for (int done = 0; done < numFrames; ) {
+        const int count = std::min(framesPerBlock, numFrames - done);
+        unsigned char* out = block;
+        for (int i = done; i < done + count; ++i) {
+            for (int channel = 0; channel < numChannels; ++channel) {
+                if (bitsPerSample == 32) {
+                    const float value = (float)channels[channel][i];
+                    std::memcpy(out, &value, 4);
+                    out += 4;
+                } else {
+                    const double value = (double)channels[channel][i];
+                    std::memcpy(out, &value, 8);
+                    out += 8;
+                }
+            }
+        }
+        const std::size_t bytes = (std::size_t)(out - block);
+        const off_t offset = (off_t)(headerBytes + (start + done)*frameBytes);
+        if (pwrite(descriptor, block, bytes, offset) != (ssize_t)bytes)
+            failed = true;
+        done += count;
+    }
+    return ! failed;
+}
+
+template bool WavWriter::write<float>(std::int64_t, const float* const*, int);
+template bool WavWriter::write<double>(std::int64_t, const double* const*, int);
+
+bool WavWriter::sync()
+{
+    if (descriptor >= 0 && fdatasync(descriptor) != 0)
+        failed = true;
+    return ! failed;
+}
+
+bool WavWriter::close(std::string& error)
+{
+    if (descriptor < 0)
+        return true;
+
+    if (::close(descriptor) != 0)
+        failed = true;
+    descriptor = -1;
+
+    if (failed)
+        error = "can't write " + path;
+    return ! failed;
+}
@@ -0,0 +1,101 @@
+/*
+  ==============================================================================
+
+    WavFile.h
+
+    Just enough WAV for the batch renderer. WavReader maps the whole file
+    into memory and converts frames to planar float or double as they're
+    asked for, so a render holds a block of samples rather than the file;
+    it takes 8-, 16-, 24- and 32-bit integer and 32- and 64-bit float PCM,
+    plain or WAVE_FORMAT_EXTENSIBLE. WavWriter writes 32- or 64-bit float,
+    so nothing the engine produces is rounded or clipped on the way out,
+    into a file sized up front for the frames to come; each write goes
+    straight to its own frames, so several threads can fill in one file,
+    and a render that stopped partway can reopen its file and carry on.
+
+    POSIX only (mmap). RF64 and compressed formats aren't read.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+class WavReader
+{
+public:
+    WavReader() = default;
+    ~WavReader();
+
+    /* maps path and reads its header; false with error set if it can't be read */
+    bool open(const std::string& path, std::string& error);
+
+    int getNumChannels() const { return numChannels; }
+    double getSampleRate() const { return sampleRate; }
+    std::int64_t getNumFrames() const { return numFrames; }
+
+    /* numFrames frames from start into channels, converted to [-1, 1);
+       frames past the end of the file read as silence */
+    template <typename SampleType>
+    void read(std::int64_t start, int numFrames, SampleType* const* channels) const;
+
+private:
+    enum class Encoding { unsignedInt, signedInt, floatingPoint };
+
+    const unsigned char* mapping {nullptr};
+    std::size_t mappingSize {0};
+    const unsigned char* data {nullptr};
+
+    Encoding encoding {Encoding::signedInt};
+    int numChannels {0}, bytesPerSample {0};
+    double sampleRate {0.0};
+    std::int64_t numFrames {0};
+
+    double sampleAt(const unsigned char* sample) const;
+
+    WavReader(const WavReader&) = delete;
+    WavReader& operator=(const WavReader&) = delete;
+};
+
+class WavWriter
+{
+public:
+    WavWriter() = default;
+    ~WavWriter();
+
+    /* creates path, sized for numFrames frames of bitsPerSample-bit float (32 or 64) */
+    bool open(const std::string& path, double sampleRate, int numChannels, int bitsPerSample,
+              std::int64_t numFrames, std::string& error);
+
+    /* as open(), but keeps the frames already in path, which an earlier open()
+       with the same arguments must have created, so a render can carry on */
+    bool reopen(const std::string& path, double sampleRate, int numChannels, int bitsPerSample,
+                std::int64_t numFrames, std::string& error);
+
+    /* numFrames planar frames from frame start on, interleaved on the way;
+       any thread, as long as no two write the same frames at once */
+    template <typename SampleType>
+    bool write(std::int64_t start, const SampleType* const* channels, int numFrames);
+
+    /* returns once everything written so far is on disk */
+    bool sync();
+
+    /* false if anything failed to write */
+    bool close(std::string& error);
+
+private:
+    int descriptor {-1};
+    std::string path;
+    int numChannels {0}, bitsPerSample {0};
+    std::int64_t headerBytes {0};
+    std::atomic<bool> failed {false};
+
+    bool create(const std::string& path, double sampleRate, int numChannels, int bitsPerSample,
+                std::int64_t numFrames, bool keepFrames, std::string& error);
+
+    WavWriter(const WavWriter&) = delete;
+    WavWriter& operator=(const WavWriter&) = delete;
+};